@@ -5,24 +5,315 @@
 #ifndef __GONG_AUDIO_H
 #define __GONG_AUDIO_H
 
-#include <zephyr/sys/printk.h>
 
 #include <zephyr/device.h>
 
+#include <driver_stm32dac.h>
+
+//IDs, offsets, sizes and WAV headers of the assets in the blob, generated from app/audio
+#include "gong_audio_assets.h"
+
+//the audio asset blob at the start of the .audioData flash section, see gong_audio_blob.S.
+//the size is only used by the compile time descriptors, the directory lookup doesn't depend on it,
+//so another blob can be flashed there without relinking the application
+extern "C" const uint8_t gong_audio_blob[GONG_AUDIO_BLOB_SIZE];
+
+//"GONG" read as a little-endian word
+#define GONG_AUDIO_MAGIC 0x474E4F47
+
 /**
- * Contains audio data in the WAV format stored in the flash
+ * The asset directory at the start of the blob, see scripts/gong_assets.py
+ */
+struct GongAudioDirectory
+{
+    uint32_t magic;
+    uint16_t version;
+    //the number of entries that follow the directory
+    uint16_t count;
+};
+
+/**
+ * The directory entry of an asset, the asset ID is the index of the entry
+ */
+struct GongAudioEntry
+{
+    //from the start of the blob
+    uint32_t offset;
+    uint32_t length;
+    uint32_t sampleCount;
+    uint32_t sampleRate;
+    uint32_t loopStart;
+    uint32_t loopEnd;
+    uint16_t format;
+    uint16_t bitsPerSample;
+    uint16_t blockAlign;
+    uint16_t loopCount;
+};
+
+static_assert(sizeof(GongAudioDirectory) == 8, "the directory layout is set by gong_assets.py");
+static_assert(sizeof(GongAudioEntry) == 32, "the entry layout is set by gong_assets.py");
+
+/**
+ * Parses and validates the WAV headers of the assets at compile time
+ */
+namespace GongWav
+{
+    //the WAV format tags the DAC driver plays
+    constexpr uint16_t FormatPcm = 0x0001;
+    constexpr uint16_t FormatAlaw = 0x0006;
+    constexpr uint16_t FormatMulaw = 0x0007;
+    constexpr uint16_t FormatImaAdpcm = 0x0011;
+    constexpr uint16_t FormatDac12R = 0xDAC1;
+    constexpr uint16_t FormatDac12L = 0xDAC2;
+    constexpr uint16_t FormatLossless = 0xDAC3;
+
+    //the sample rates the player supports
+    constexpr uint32_t SupportedRates[] = {8000, 11025, 16000, 22050, 24000, 32000, 44100, 48000};
+
+#ifdef CONFIG_TIMER_READS_ITS_FREQUENCY_AT_RUNTIME
+    //the clock isn't known at compile time, the driver finds the timer autoreload value
+    constexpr uint32_t TimerClock = 0;
+#else
+    //TIM6 counts the system clock
+    constexpr uint32_t TimerClock = CONFIG_SYS_CLOCK_HW_CYCLES_PER_SEC;
+#endif
+
+    enum class Error
+    {
+        None,
+        NotRiff,
+        NoFmt,
+        NotMono,
+        Format,
+        Rate,
+        NoData,
+        Loop,
+    };
+
+    /**
+     * What the WAV header says about the audio
+     */
+    struct Header
+    {
+        Error error;
+        uint16_t format;
+        uint16_t channels;
+        uint32_t sampleRate;
+        uint16_t blockAlign;
+        uint16_t bitsPerSample;
+        //from the fact chunk, 0 if there is none
+        uint32_t sampleCount;
+        uint32_t dataSize;
+        //the first loop of the smpl chunk, loopEnd is the sample after the last one
+        uint32_t loopStart;
+        uint32_t loopEnd;
+        uint32_t loopCount;
+    };
+
+    constexpr uint16_t le16(const uint8_t *p)
+    {
+        return p[0] | (p[1] << 8);
+    }
+
+    constexpr uint32_t le32(const uint8_t *p)
+    {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    constexpr bool isTag(const uint8_t *p, const char *tag)
+    {
+        return (p[0] == tag[0]) && (p[1] == tag[1]) && (p[2] == tag[2]) && (p[3] == tag[3]);
+    }
+
+    //the formats and sample sizes the DAC driver plays
+    constexpr bool isFormatSupported(uint16_t format, uint16_t bits)
+    {
+        switch (format) {
+            case FormatPcm:
+                return (bits == 16) || (bits == 8);
+            case FormatImaAdpcm:
+                return bits == 4;
+            case FormatMulaw:
+            case FormatAlaw:
+                return bits == 8;
+            case FormatDac12R:
+            case FormatDac12L:
+            case FormatLossless:
+                return bits == 16;
+            default:
+                return false;
+        }
+    }
+
+    //the rate is a standard one and the timer period fits TIM6
+    constexpr bool isRateSupported(uint32_t rate)
+    {
+        for (uint32_t supported : SupportedRates) {
+            if (rate == supported) {
+                return (TimerClock == 0) || ((TimerClock / rate - 1) <= 0xFFFF);
+            }
+        }
+
+        return false;
+    }
+
+    //0 lets the driver find it at run time
+    constexpr uint16_t timerAutoreload(uint32_t rate)
+    {
+        return (TimerClock == 0) ? 0 : (uint16_t)(TimerClock / rate - 1);
+    }
+
+    /**
+     * Parses the WAV header up to the data chunk header
+     */
+    template <size_t N>
+    constexpr Header parse(const uint8_t (&wav)[N])
+    {
+        Header header{};
+        bool fmt = false;
+        bool data = false;
+
+        if ((N < 12) || !isTag(wav, "RIFF") || !isTag(wav + 8, "WAVE")) {
+            header.error = Error::NotRiff;
+            return header;
+        }
+
+        size_t pos = 12;
+        while (pos + 8 <= N) {
+            const uint8_t *chunk = wav + pos;
+            uint32_t size = le32(chunk + 4);
+
+            //the samples follow the data chunk header
+            if (isTag(chunk, "data")) {
+                header.dataSize = size;
+                data = true;
+                break;
+            }
+
+            if (pos + 8 + size > N) {
+                break;
+            }
+
+            if (isTag(chunk, "fmt ") && (size >= 16)) {
+                header.format = le16(chunk + 8);
+                header.channels = le16(chunk + 10);
+                header.sampleRate = le32(chunk + 12);
+                header.blockAlign = le16(chunk + 20);
+                header.bitsPerSample = le16(chunk + 22);
+                fmt = true;
+            } else if (isTag(chunk, "fact") && (size >= 4)) {
+                header.sampleCount = le32(chunk + 8);
+            } else if (isTag(chunk, "smpl") && (size >= 60) && (le32(chunk + 36) > 0)) {
+                //the loops follow 9 words, the loop end is inclusive
+                header.loopStart = le32(chunk + 52);
+                header.loopEnd = le32(chunk + 56) + 1;
+                header.loopCount = le32(chunk + 64);
+            }
+
+            //chunks are padded to an even size
+            pos += 8 + size + (size & 1);
+        }
+
+        if (!fmt) {
+            header.error = Error::NoFmt;
+        } else if (header.channels != 1) {
+            header.error = Error::NotMono;
+        } else if (!isFormatSupported(header.format, header.bitsPerSample)) {
+            header.error = Error::Format;
+        } else if (!isRateSupported(header.sampleRate)) {
+            header.error = Error::Rate;
+        } else if (!data) {
+            header.error = Error::NoData;
+        } else if ((header.sampleCount == 0) && (header.format != FormatImaAdpcm) && (header.format != FormatLossless)) {
+            header.sampleCount = header.dataSize / (header.bitsPerSample / 8);
+        }
+
+        if ((header.error == Error::None) && (header.loopEnd != 0)
+            && ((header.loopStart >= header.loopEnd) || (header.loopEnd > header.sampleCount) || (header.loopCount > 0xFFFF))) {
+            header.error = Error::Loop;
+        }
+
+        return header;
+    }
+
+    /**
+     * Builds the descriptor the DAC driver plays without parsing anything
+     */
+    constexpr struct stm32dac_asset describe(const Header &header, const uint8_t *data)
+    {
+        return {
+            data,
+            header.dataSize,
+            header.sampleCount,
+            header.sampleRate,
+            header.loopStart,
+            header.loopEnd,
+            header.format,
+            header.bitsPerSample,
+            header.blockAlign,
+            timerAutoreload(header.sampleRate),
+            (uint16_t)header.loopCount,
+        };
+    }
+}
+
+//an asset with an invalid WAV header fails the build
+#define GONG_AUDIO_VALIDATE(NAME) \
+    static_assert(GongWav::parse(GONG_AUDIO_##NAME##_WAV_HEADER).error != GongWav::Error::NotRiff, \
+        "GONG_AUDIO_" #NAME ": not a RIFF/WAVE file"); \
+    static_assert(GongWav::parse(GONG_AUDIO_##NAME##_WAV_HEADER).error != GongWav::Error::NoFmt, \
+        "GONG_AUDIO_" #NAME ": no fmt chunk"); \
+    static_assert(GongWav::parse(GONG_AUDIO_##NAME##_WAV_HEADER).error != GongWav::Error::NotMono, \
+        "GONG_AUDIO_" #NAME ": only mono audio is supported"); \
+    static_assert(GongWav::parse(GONG_AUDIO_##NAME##_WAV_HEADER).error != GongWav::Error::Format, \
+        "GONG_AUDIO_" #NAME ": unsupported format or bits per sample"); \
+    static_assert(GongWav::parse(GONG_AUDIO_##NAME##_WAV_HEADER).error != GongWav::Error::Rate, \
+        "GONG_AUDIO_" #NAME ": unsupported sample rate"); \
+    static_assert(GongWav::parse(GONG_AUDIO_##NAME##_WAV_HEADER).error != GongWav::Error::NoData, \
+        "GONG_AUDIO_" #NAME ": no data chunk"); \
+    static_assert(GongWav::parse(GONG_AUDIO_##NAME##_WAV_HEADER).error != GongWav::Error::Loop, \
+        "GONG_AUDIO_" #NAME ": the loop is outside the audio"); \
+    static_assert(GongWav::parse(GONG_AUDIO_##NAME##_WAV_HEADER).dataSize == GONG_AUDIO_##NAME##_SIZE, \
+        "GONG_AUDIO_" #NAME ": the WAV header doesn't match the asset");
+
+GONG_AUDIO_ASSET_LIST(GONG_AUDIO_VALIDATE)
+
+#define GONG_AUDIO_DESCRIPTOR(NAME) \
+    GongWav::describe(GongWav::parse(GONG_AUDIO_##NAME##_WAV_HEADER), &gong_audio_blob[GONG_AUDIO_##NAME##_OFFSET]),
+
+/**
+ * Finds the audio assets stored in the flash
  */
 class GongAudio
 {
     public:
-        //the single  note sound data array
-        const static uint8_t singleSoundData[178460];
+        //the descriptors of the linked assets built at compile time, the index is the asset ID
+        static constexpr struct stm32dac_asset assets[GONG_AUDIO_COUNT] = {
+            GONG_AUDIO_ASSET_LIST(GONG_AUDIO_DESCRIPTOR)
+        };
+
+        /**
+         * Gets the asset by its ID, GONG_AUDIO_<NAME>, from the directory in the flash
+         *
+         * @param uint16_t id The asset ID
+         * @param stm32dac_asset *asset The asset to fill in
+         *
+         * @return true if the blob has the asset
+         */
+        static bool get(uint16_t id, struct stm32dac_asset *asset);
 
-        //the three notes sound data
-        //repeat three times without a delay
-        const static uint8_t threeSoundData[134594];
+        /**
+         * Gets the number of assets in the blob
+         *
+         * @return The number of assets, 0 if the directory isn't valid
+         */
+        static uint16_t count();
+
+    private:
+
+        //the directory if it's valid, nullptr otherwise
+        static const GongAudioDirectory *directory();
 
 };
 
 #endif
-
@@ -5,7 +5,6 @@
 #ifndef __GONG_PLAYER_H
 #define __GONG_PLAYER_H
 
-#include <zephyr/sys/printk.h>
 #include <zephyr/device.h>
 #include <zephyr/devicetree.h>
 
@@ -22,28 +21,75 @@ class GongPlayer
         GongPlayer();
 
         /**
-         * Plays a signal depending on the wakeup pin
+         * Starts playing a signal depending on the wakeup pin
+         *
+         * The repeats are timed by the DAC driver and played by its thread,
+         * the call returns at once, see wait.
          *
          * @param int32_t wakeupPin The wakeup pin
+         * @param uint16_t repeatTimes How many times to play the signal
+         * @param uint16_t repeatDelay The pause between the plays in milliseconds
+         *
+         * @return 0 if the signal has been started, -ENOENT if the pin has no signal
+         */
+        int play(int32_t wakeupPin, uint16_t repeatTimes = 1, uint16_t repeatDelay = 0);
+
+        /**
+         * Waits for the signal to end
+         *
+         * The player must not be destroyed before the signal has ended.
+         *
+         * @param k_timeout_t timeout How long to wait
+         *
+         * @return true if the signal has ended or nothing has been played
+         */
+        bool wait(k_timeout_t timeout);
+
+        /**
+         * Cancels the signal that is playing, it can be called from another thread
          */
-        void play(int32_t wakeupPin);
+        void cancel();
+
+        /**
+         * Sets up the DAC before the first signal, so the signal starts at once
+         */
+        static void prepare();
 
     private:
 
         //the DAC device
         const struct device *dac;
 
+        //given when the signal has ended
+        struct k_sem done;
+
+        /**
+         * Called by the DAC driver thread when the signal has ended
+         */
+        static void played(const struct device *dev, int result, void *userData);
+
+        /**
+         * Plays an audio asset
+         *
+         * @param uint16_t assetId The asset ID, GONG_AUDIO_<NAME>
+         * @param uint16_t playTimes How many times to play the asset
+         * @param uint16_t playDelay The delay before the next play
+         *
+         * @return 0 if the play has been started
+         */
+        int playAsset(uint16_t assetId, uint16_t playTimes, uint16_t playDelay);
+
         //play the Gong T1 sound
-        void playT1();
+        int playT1(uint16_t repeatTimes, uint16_t repeatDelay);
 
         //play the Gong T2 sound
-        void playT2();
+        int playT2(uint16_t repeatTimes, uint16_t repeatDelay);
 
         //play the Gong T3 sound
-        void playT3();
+        int playT3(uint16_t repeatTimes, uint16_t repeatDelay);
 
         //play the Gong T4 sound
-        void playT4();
+        int playT4(uint16_t repeatTimes, uint16_t repeatDelay);
 
 };
 
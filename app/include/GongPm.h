@@ -5,7 +5,6 @@
 #ifndef __GONG_PM_H
 #define __GONG_PM_H
 
-#include <zephyr/sys/printk.h>
 
 #include <zephyr/device.h>
 #include <zephyr/devicetree.h>
@@ -31,10 +30,52 @@ class GongPm
         int isWakeupPinActive();
 
         /**
-         * Puts the system into the standby mode
+         * Gets every wakeup pin that has awaken the system, the bits of LL_PWR_WAKEUP_PIN*
+         */
+        uint32_t getWokenPins();
+
+        /**
+         * Gets the wakeup pins that are active now, the bits of LL_PWR_WAKEUP_PIN*
+         */
+        uint32_t getActivePins();
+
+        /**
+         * Gets how many wakes have been rejected as glitches since the power on
+         */
+        uint32_t getRejectedWakes();
+
+        /**
+         * Calls the callback from the GPIO interrupt when a wakeup pin is released
+         *
+         * @param stm32pm_release_callback_t callback The callback
+         * @param void* userData Passed to the callback
+         */
+        int onWakeupPinRelease(stm32pm_release_callback_t callback, void *userData);
+
+        /**
+         * Gets why the system has started
+         */
+        enum stm32pm_wake_cause getWakeCause();
+
+        /**
+         * Puts the system into the standby mode until an active wakeup pin is released
+         *
+         * @param uint32_t timeoutSeconds The longest wait, the system wakes up after it
+         */
+        void standbyUntilRelease(uint32_t timeoutSeconds);
+
+        /**
+         * Puts the system into the standby mode, or the shutdown mode
+         * with CONFIG_GONG_PM_SHUTDOWN
          */
         void standby();
 
+        /**
+         * Sleeps in the stop2 mode until an interrupt, a wakeup pin change included,
+         * the RAM is kept
+         */
+        void stop2();
+
     private:
         
         //the PM device
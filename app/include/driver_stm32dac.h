@@ -13,6 +13,7 @@
 #define ZEPHYR_INCLUDE_DRIVERS_STM32DAC_H_
 
 #include <zephyr/device.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -25,6 +26,52 @@ extern "C" {
  * @{
  */
 
+/**
+ * @brief An audio asset that is ready to be played
+ *
+ * It has everything the WAV header would have, so the driver
+ * doesn't parse anything before playing it.
+ */
+struct stm32dac_asset {
+    /** The encoded samples, without a header */
+    const uint8_t *data;
+    /** The size of the data in bytes */
+    uint32_t length;
+    /** The number of samples, 0 if it can be found from the length */
+    uint32_t sample_count;
+    /** Samples per second */
+    uint32_t sample_rate;
+    /** The first sample of the loop */
+    uint32_t loop_start;
+    /** The sample after the last one of the loop, 0 if there is no loop */
+    uint32_t loop_end;
+    /** The WAV format tag of the data */
+    uint16_t format;
+    uint16_t bits_per_sample;
+    /** The size of a block of the block based formats */
+    uint16_t block_align;
+    /** TIM6 autoreload value for the sample rate, 0 to let the driver find it */
+    uint16_t timer_autoreload;
+    /** How many times the loop is played in a row, 0 or 1 plays the audio straight through */
+    uint16_t loop_count;
+};
+
+/** @brief What the DAC is doing, see stm32dac_playback_status */
+enum stm32dac_status {
+    /** Nothing is playing, a new play can be started */
+    STM32DAC_STATUS_IDLE,
+    /** A play has been started and hasn't ended yet */
+    STM32DAC_STATUS_PLAYING,
+};
+
+/**
+ * @brief Called by the driver thread when an asynchronous play has ended
+ *
+ * @param dev        Pointer to the device structure for the driver instance
+ * @param result     0 on success, or the error the blocking play would have returned
+ * @param user_data  The pointer given to the play
+ */
+typedef void (*stm32dac_play_callback_t)(const struct device *dev, int result, void *user_data);
 
 /*
  * Type definition of DAC API function for playing audio.
@@ -33,12 +80,53 @@ typedef int (*stm32dac_api_play_audio)(const struct device *dev,
     uint8_t const* audio_data, const uint16_t play_times, const uint16_t play_delay);
 
 
+/*
+ * Type definition of DAC API function for playing an audio asset several times.
+ */
+typedef int (*stm32dac_api_play_repeated)(const struct device *dev,
+    const struct stm32dac_asset *asset, const uint16_t play_times, const uint32_t gap_samples);
+
+
+/*
+ * Type definition of DAC API function for starting to play audio without waiting for the end.
+ */
+typedef int (*stm32dac_api_play_audio_async)(const struct device *dev,
+    uint8_t const* audio_data, const uint16_t play_times, const uint16_t play_delay,
+    stm32dac_play_callback_t callback, void *user_data);
+
+
+/*
+ * Type definition of DAC API function for starting to play an audio asset without waiting for the end.
+ */
+typedef int (*stm32dac_api_play_repeated_async)(const struct device *dev,
+    const struct stm32dac_asset *asset, const uint16_t play_times, const uint32_t gap_samples,
+    stm32dac_play_callback_t callback, void *user_data);
+
+
+/*
+ * Type definition of DAC API function for getting the playback status.
+ */
+typedef enum stm32dac_status (*stm32dac_api_playback_status)(const struct device *dev);
+
+
+/*
+ * Type definition of DAC API function for cancelling the play.
+ */
+typedef int (*stm32dac_api_cancel)(const struct device *dev);
+
+
 /*
  * Type definition of STM32 DAC API function for stopping the DAC.
  */
 typedef int (*stm32dac_api_stop)(const struct device *dev);
 
 
+/*
+ * Type definition of DAC API function for setting up the peripherals before the first play.
+ */
+typedef int (*stm32dac_api_prepare)(const struct device *dev);
+
+
 /*
  * STM32 DAC driver API
  *
@@ -46,7 +134,13 @@ typedef int (*stm32dac_api_stop)(const struct device *dev);
  */
 __subsystem struct stm32dac_driver_api {
     stm32dac_api_play_audio play_audio;
+    stm32dac_api_play_repeated play_repeated;
+    stm32dac_api_play_audio_async play_audio_async;
+    stm32dac_api_play_repeated_async play_repeated_async;
+    stm32dac_api_playback_status playback_status;
+    stm32dac_api_cancel cancel;
     stm32dac_api_stop stop;
+    stm32dac_api_prepare prepare;
 };
 
 /**
@@ -61,8 +155,12 @@ __subsystem struct stm32dac_driver_api {
  * @param play_times  How many times to play the audio
  * @param play_delay  The delay before the next play 
  *
- * @retval 0        On success.
- * @retval -EINVAL  If a parameter with an invalid value has been provided.
+ * @retval 0           On success.
+ * @retval -EINVAL     If a parameter with an invalid value has been provided.
+ * @retval -EIO        If DMA has stopped sending the audio data.
+ * @retval -EBADMSG    If the compressed audio data is corrupt.
+ * @retval -ECANCELED  If the play has been cancelled.
+ * @retval -EBUSY      If another play hasn't ended yet.
  */
 static inline int stm32dac_play_audio(const struct device *dev, uint8_t const* audio_data, 
     const uint16_t play_times, const uint16_t play_delay)
@@ -72,6 +170,164 @@ static inline int stm32dac_play_audio(const struct device *dev, uint8_t const* a
     return api->play_audio(dev, audio_data, play_times, play_delay);
 }
 
+/**
+ * @brief Play an audio asset via DAC 
+ *
+ * @param dev         Pointer to the device structure for the driver instance
+ * @param asset       The audio asset
+ * @param play_times  How many times to play the audio
+ * @param play_delay  The delay before the next play in milliseconds
+ *
+ * @retval 0           On success.
+ * @retval -EINVAL     If a parameter with an invalid value has been provided.
+ * @retval -EIO        If DMA has stopped sending the audio data.
+ * @retval -EBADMSG    If the compressed audio data is corrupt.
+ * @retval -ECANCELED  If the play has been cancelled.
+ * @retval -EBUSY      If another play hasn't ended yet.
+ */
+static inline int stm32dac_play_asset(const struct device *dev, const struct stm32dac_asset *asset, 
+    const uint16_t play_times, const uint16_t play_delay)
+{
+    const struct stm32dac_driver_api *api = (const struct stm32dac_driver_api *)dev->api;
+
+    return api->play_repeated(dev, asset, play_times, ((uint64_t)play_delay * asset->sample_rate) / 1000);
+}
+
+/**
+ * @brief Play an audio asset several times with silence between plays
+ *
+ * The timer and DMA keep running through the silence, so the timing is sample exact,
+ * and the calling thread sleeps until the last play ends or the play is cancelled.
+ *
+ * @param dev          Pointer to the device structure for the driver instance
+ * @param asset        The audio asset
+ * @param play_times   How many times to play the audio
+ * @param gap_samples  The silence between plays in samples
+ *
+ * @retval 0           On success.
+ * @retval -EINVAL     If a parameter with an invalid value has been provided.
+ * @retval -EIO        If DMA has stopped sending the audio data.
+ * @retval -EBADMSG    If the compressed audio data is corrupt.
+ * @retval -ECANCELED  If the play has been cancelled.
+ * @retval -EBUSY      If another play hasn't ended yet.
+ */
+static inline int stm32dac_play_repeated(const struct device *dev, const struct stm32dac_asset *asset, 
+    const uint16_t play_times, const uint32_t gap_samples)
+{
+    const struct stm32dac_driver_api *api = (const struct stm32dac_driver_api *)dev->api;
+
+    return api->play_repeated(dev, asset, play_times, gap_samples);
+}
+
+/**
+ * @brief Start playing audio data in the WAV format without waiting for the end
+ *
+ * The driver thread plays the audio, see stm32dac_play_audio, and calls the callback
+ * with the result when it has ended.
+ *
+ * @param dev         Pointer to the device structure for the driver instance
+ * @param audio_data  Audio data in the WAV format, it must stay valid until the callback
+ * @param play_times  How many times to play the audio
+ * @param play_delay  The delay before the next play in milliseconds
+ * @param callback    Called from the driver thread when the play has ended, can be NULL
+ * @param user_data   Passed to the callback
+ *
+ * @retval 0        On success, the play has been started.
+ * @retval -EINVAL  If a parameter with an invalid value has been provided.
+ * @retval -EBUSY   If another play hasn't ended yet.
+ */
+static inline int stm32dac_play_audio_async(const struct device *dev, uint8_t const* audio_data, 
+    const uint16_t play_times, const uint16_t play_delay,
+    stm32dac_play_callback_t callback, void *user_data)
+{
+    const struct stm32dac_driver_api *api = (const struct stm32dac_driver_api *)dev->api;
+
+    return api->play_audio_async(dev, audio_data, play_times, play_delay, callback, user_data);
+}
+
+/**
+ * @brief Start playing an audio asset without waiting for the end
+ *
+ * The asset descriptor is copied, the audio data it points to must stay valid until the callback.
+ *
+ * @param dev         Pointer to the device structure for the driver instance
+ * @param asset       The audio asset
+ * @param play_times  How many times to play the audio
+ * @param play_delay  The delay before the next play in milliseconds
+ * @param callback    Called from the driver thread when the play has ended, can be NULL
+ * @param user_data   Passed to the callback
+ *
+ * @retval 0        On success, the play has been started.
+ * @retval -EINVAL  If a parameter with an invalid value has been provided.
+ * @retval -EBUSY   If another play hasn't ended yet.
+ */
+static inline int stm32dac_play_asset_async(const struct device *dev, const struct stm32dac_asset *asset, 
+    const uint16_t play_times, const uint16_t play_delay,
+    stm32dac_play_callback_t callback, void *user_data)
+{
+    const struct stm32dac_driver_api *api = (const struct stm32dac_driver_api *)dev->api;
+
+    return api->play_repeated_async(dev, asset, play_times, 
+        ((uint64_t)play_delay * asset->sample_rate) / 1000, callback, user_data);
+}
+
+/**
+ * @brief Start playing an audio asset several times without waiting for the end
+ *
+ * @param dev          Pointer to the device structure for the driver instance
+ * @param asset        The audio asset, the descriptor is copied
+ * @param play_times   How many times to play the audio
+ * @param gap_samples  The silence between plays in samples
+ * @param callback     Called from the driver thread when the play has ended, can be NULL
+ * @param user_data    Passed to the callback
+ *
+ * @retval 0        On success, the play has been started.
+ * @retval -EINVAL  If a parameter with an invalid value has been provided.
+ * @retval -EBUSY   If another play hasn't ended yet.
+ */
+static inline int stm32dac_play_repeated_async(const struct device *dev, const struct stm32dac_asset *asset, 
+    const uint16_t play_times, const uint32_t gap_samples,
+    stm32dac_play_callback_t callback, void *user_data)
+{
+    const struct stm32dac_driver_api *api = (const struct stm32dac_driver_api *)dev->api;
+
+    return api->play_repeated_async(dev, asset, play_times, gap_samples, callback, user_data);
+}
+
+/**
+ * @brief Gets the playback status
+ *
+ * @param dev  Pointer to the device structure for the driver instance
+ *
+ * @retval STM32DAC_STATUS_PLAYING  If a play has been started and hasn't ended yet.
+ * @retval STM32DAC_STATUS_IDLE     Otherwise.
+ */
+static inline enum stm32dac_status stm32dac_playback_status(const struct device *dev)
+{
+    const struct stm32dac_driver_api *api = (const struct stm32dac_driver_api *)dev->api;
+
+    return api->playback_status(dev);
+}
+
+/**
+ * @brief Cancels the play, the playing thread returns -ECANCELED
+ *
+ * It can be called from another thread or an interrupt.
+ * The output is ramped to the middle of the range in a few milliseconds
+ * and the amplifier is disabled before the play returns.
+ * An asynchronous play ends with the callback getting -ECANCELED.
+ *
+ * @param dev         Pointer to the device structure for the driver instance.
+ *
+ * @retval 0        On success.
+ */
+static inline int stm32dac_cancel(const struct device *dev)
+{
+    const struct stm32dac_driver_api *api = (const struct stm32dac_driver_api *)dev->api;
+
+    return api->cancel(dev);
+}
+
 /**
  * @brief Stops the DAC 
  *
@@ -87,6 +343,24 @@ static inline int stm32dac_stop(const struct device *dev)
     return api->stop(dev);
 }
 
+/**
+ * @brief Sets up the DAC, DMA and TIM6 before the first play
+ *
+ * The first play does it otherwise. After it a play only writes the audio address,
+ * its length and the timer autoreload value for a new sample rate.
+ *
+ * @param dev         Pointer to the device structure for the driver instance.
+ *
+ * @retval 0        On success, also if the setup has been done already.
+ * @retval -EBUSY   If a play is in progress before the setup has run.
+ */
+static inline int stm32dac_prepare(const struct device *dev)
+{
+    const struct stm32dac_driver_api *api = (const struct stm32dac_driver_api *)dev->api;
+
+    return api->prepare(dev);
+}
+
 
 /**
  * @}
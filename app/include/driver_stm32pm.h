@@ -12,6 +12,7 @@
 #ifndef ZEPHYR_INCLUDE_DRIVERS_STM32PM_H_
 #define ZEPHYR_INCLUDE_DRIVERS_STM32PM_H_
 
+#include <zephyr/kernel.h>
 #include <zephyr/device.h>
 
 #ifdef __cplusplus
@@ -25,6 +26,59 @@ extern "C" {
  * @{
  */
 
+/**
+ * @brief The pin event of a wakeup pin going to the active level
+ *
+ * @param wakeup_pin  The wakeup pin, one of LL_PWR_WAKEUP_PIN*
+ */
+#define STM32PM_EVENT_ACTIVE(wakeup_pin) ((uint32_t)(wakeup_pin))
+
+/**
+ * @brief The pin event of a wakeup pin going to the inactive level
+ *
+ * @param wakeup_pin  The wakeup pin, one of LL_PWR_WAKEUP_PIN*
+ */
+#define STM32PM_EVENT_RELEASED(wakeup_pin) ((uint32_t)(wakeup_pin) << 8)
+
+/**
+ * @brief The substates of stm32pm_state_set
+ */
+/** PM_STATE_STANDBY: the wakeup pins and the RTC wake the system, the RAM is lost */
+#define STM32PM_SUBSTATE_STANDBY 0
+/** PM_STATE_STANDBY: tens of nA, the wakeup pins cold boot the system, LSI and the RTC are off */
+#define STM32PM_SUBSTATE_SHUTDOWN 1
+/** PM_STATE_SUSPEND_TO_IDLE: the RAM is kept, any EXTI interrupt wakes the system in microseconds */
+#define STM32PM_SUBSTATE_STOP2 2
+
+/** @brief Why the system has started, see stm32pm_wake_cause_get */
+enum stm32pm_wake_cause {
+    /** A reset or power on */
+    STM32PM_WAKE_RESET,
+    /** A wakeup pin has become active, stm32pm_wakeup_pin_get tells which one */
+    STM32PM_WAKE_PIN,
+    /** A pin stm32pm_standby_until_release has waited for has been released */
+    STM32PM_WAKE_RELEASE,
+    /** The pin hasn't been released before the timeout of stm32pm_standby_until_release */
+    STM32PM_WAKE_TIMEOUT,
+};
+
+/** @brief The wakeup pins, the bits of LL_PWR_WAKEUP_PIN* */
+struct stm32pm_wakeup_pins {
+    /** Every pin whose wakeup flag has been set at the start */
+    uint32_t woken;
+    /** The pins that are at the active level now */
+    uint32_t active;
+};
+
+/**
+ * @brief Called from the GPIO interrupt when a wakeup pin has been released
+ *
+ * @param dev         Pointer to the device structure for the driver instance
+ * @param wakeup_pin  The wakeup pin that has been released
+ * @param user_data   The pointer given with the callback
+ */
+typedef void (*stm32pm_release_callback_t)(const struct device *dev, int32_t wakeup_pin, void *user_data);
+
 /**
  * @brief Get the wakeup pin that caused the processor to exit from the Standby mode
  *
@@ -40,6 +94,49 @@ typedef int32_t (*stm32pm_api_wakeup_pin_get)(const struct device *dev);
 typedef int (*stm32pm_api_wakeup_pin_active)(const struct device *dev);
 
 
+/**
+ * @brief Get every wakeup pin that has woken the system and the active ones
+ *
+ * @return int 0 on success
+ */
+typedef int (*stm32pm_api_wakeup_pins_get)(const struct device *dev, struct stm32pm_wakeup_pins *pins);
+
+/**
+ * @brief Get how many wakes have been rejected as glitches
+ *
+ * @return uint32_t The number of the rejected wakes
+ */
+typedef uint32_t (*stm32pm_api_rejected_wakes_get)(const struct device *dev);
+
+/**
+ * @brief Set the callback for the release of the wakeup pins
+ *
+ * @return int 0 on success
+ */
+typedef int (*stm32pm_api_wakeup_pin_release_callback_set)(const struct device *dev,
+    stm32pm_release_callback_t callback, void *user_data);
+
+/**
+ * @brief Wait for any of the pin events
+ *
+ * @return uint32_t The events that have been posted
+ */
+typedef uint32_t (*stm32pm_api_pin_event_wait)(const struct device *dev, uint32_t events, k_timeout_t timeout);
+
+/**
+ * @brief Go into the Standby mode until the active wakeup pin is released
+ *
+ * @return int 0 on success
+ */
+typedef int (*stm32pm_api_standby_until_release)(const struct device *dev, uint32_t timeout_s);
+
+/**
+ * @brief Get why the system has started
+ *
+ * @return enum stm32pm_wake_cause The cause
+ */
+typedef enum stm32pm_wake_cause (*stm32pm_api_wake_cause_get)(const struct device *dev);
+
 /**
  * @brief Put processor into a power state.
  *
@@ -61,6 +158,12 @@ typedef int (*stm32pm_api_state_set)(const struct device *dev, enum pm_state sta
 __subsystem struct stm32pm_driver_api {
     stm32pm_api_wakeup_pin_get wakeup_pin_get;
     stm32pm_api_wakeup_pin_active wakeup_pin_active;
+    stm32pm_api_wakeup_pin_release_callback_set wakeup_pin_release_callback_set;
+    stm32pm_api_pin_event_wait pin_event_wait;
+    stm32pm_api_standby_until_release standby_until_release;
+    stm32pm_api_wake_cause_get wake_cause_get;
+    stm32pm_api_wakeup_pins_get wakeup_pins_get;
+    stm32pm_api_rejected_wakes_get rejected_wakes_get;
     stm32pm_api_state_set state_set;
 };
 
@@ -74,10 +177,16 @@ __subsystem struct stm32pm_driver_api {
  * This function implements the SoC specific details necessary
  * to put the processor into available power states.
  *
+ * PM_STATE_STANDBY with STM32PM_SUBSTATE_STANDBY or STM32PM_SUBSTATE_SHUTDOWN
+ * doesn't return, the system starts from the reset after a wakeup pin.
+ * PM_STATE_SUSPEND_TO_IDLE with STM32PM_SUBSTATE_STOP2 returns after an interrupt
+ * has woken the system up, the system clock is set up again. The kernel clock
+ * doesn't count in Stop2.
+ *
  * @param state Power state.
- * @param substate_id Power substate id.
- * @retval 0        On success.
- * @retval -EINVAL  If a parameter with an invalid value has been provided.
+ * @param substate_id Power substate id, one of STM32PM_SUBSTATE_*.
+ * @retval 0         On success.
+ * @retval -ENOTSUP  If the state and the substate don't go together.
  */
 static inline int stm32pm_state_set(const struct device *dev, enum pm_state state, uint8_t substate_id)
 {
@@ -112,6 +221,110 @@ static inline int stm32pm_wakeup_pin_active(const struct device *dev)
     return api->wakeup_pin_active(dev);
 }
 
+/**
+ * @brief Calls the callback when a wakeup pin is released
+ *
+ * The callback is called from the GPIO interrupt on the edge to the inactive level,
+ * a release before the call isn't reported, check the active pins after it.
+ *
+ * @param callback   The callback, NULL to remove it
+ * @param user_data  Passed to the callback
+ *
+ * @retval 0        On success.
+ */
+static inline int stm32pm_wakeup_pin_release_callback_set(const struct device *dev,
+    stm32pm_release_callback_t callback, void *user_data)
+{
+    const struct stm32pm_driver_api *api = (const struct stm32pm_driver_api *)dev->api;
+
+    return api->wakeup_pin_release_callback_set(dev, callback, user_data);
+}
+
+/**
+ * @brief Sleeps until any of the wakeup pins changes its level
+ *
+ * The GPIO interrupts of all wakeup-gpios post the events on both edges, an event
+ * that has been posted before the call is returned at once. The returned events are cleared,
+ * call it with K_NO_WAIT to clear the old ones.
+ *
+ * @param events   STM32PM_EVENT_ACTIVE and STM32PM_EVENT_RELEASED of the pins to wait for
+ * @param timeout  How long to wait
+ *
+ * @retval uint32_t The events that have been posted, 0 on timeout
+ */
+static inline uint32_t stm32pm_pin_event_wait(const struct device *dev, uint32_t events, k_timeout_t timeout)
+{
+    const struct stm32pm_driver_api *api = (const struct stm32pm_driver_api *)dev->api;
+
+    return api->pin_event_wait(dev, events, timeout);
+}
+
+/**
+ * @brief Puts the processor into the Standby mode until any of the active wakeup pins
+ * is released
+ *
+ * The active pins are armed with the low polarity, the other wakeup pins with the high one,
+ * and the RTC wakeup timer ends the wait after the timeout. After the wake
+ * stm32pm_wake_cause_get tells if the pin has been released, the timeout has passed 
+ * or another pin has become active. It doesn't return on success.
+ *
+ * @param timeout_s  The longest wait in seconds, 1 to 65536
+ *
+ * @retval -ENODEV  If no wakeup pin is active.
+ * @retval -EINVAL  If the timeout is out of range.
+ * @retval -EAGAIN  If the pin has been released while the Standby mode was being set.
+ */
+static inline int stm32pm_standby_until_release(const struct device *dev, uint32_t timeout_s)
+{
+    const struct stm32pm_driver_api *api = (const struct stm32pm_driver_api *)dev->api;
+
+    return api->standby_until_release(dev, timeout_s);
+}
+
+/**
+ * @brief Gets why the system has started
+ *
+ * @retval enum stm32pm_wake_cause The cause
+ */
+static inline enum stm32pm_wake_cause stm32pm_wake_cause_get(const struct device *dev)
+{
+    const struct stm32pm_driver_api *api = (const struct stm32pm_driver_api *)dev->api;
+
+    return api->wake_cause_get(dev);
+}
+
+/**
+ * @brief Gets every wakeup pin that has woken the system and the pins that are active now
+ *
+ * Several signals can wake the system at once, stm32pm_wakeup_pin_get
+ * returns only the first of them.
+ *
+ * @param pins  The pins, the bits of LL_PWR_WAKEUP_PIN*
+ *
+ * @retval 0 On success.
+ */
+static inline int stm32pm_wakeup_pins_get(const struct device *dev, struct stm32pm_wakeup_pins *pins)
+{
+    const struct stm32pm_driver_api *api = (const struct stm32pm_driver_api *)dev->api;
+
+    return api->wakeup_pins_get(dev, pins);
+}
+
+/**
+ * @brief Gets how many wakes have been rejected as glitches since the power on
+ *
+ * A woken pin that doesn't keep its level through debounce-window-ms
+ * puts the system back into the Standby mode before the application starts.
+ *
+ * @retval uint32_t The number of the rejected wakes
+ */
+static inline uint32_t stm32pm_rejected_wakes_get(const struct device *dev)
+{
+    const struct stm32pm_driver_api *api = (const struct stm32pm_driver_api *)dev->api;
+
+    return api->rejected_wakes_get(dev);
+}
+
 
 /**
  * @}
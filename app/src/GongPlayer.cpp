@@ -1,64 +1,146 @@
 #include <GongPlayer.h>
 
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(gong_player, CONFIG_APP_LOG_LEVEL);
+
 GongPlayer::GongPlayer()
 {
+    k_sem_init(&done, 0, 1);
+
     dac = DEVICE_DT_GET(DT_COMPAT_GET_ANY_STATUS_OKAY(st_stm32dac));
     
     if (!dac) {
-        printk("Device STM32DAC not found.\n");
+        LOG_ERR("Device STM32DAC not found.");
     }
 
 }
 
-void GongPlayer::play(int32_t wakeupPin)
+int GongPlayer::play(int32_t wakeupPin, uint16_t repeatTimes, uint16_t repeatDelay)
 {
-    printk("wakeupPin in play: %d\n", wakeupPin);
+    LOG_DBG("wakeupPin in play: %d", wakeupPin);
+
+    int ret = -ENOENT;
+
+    k_sem_reset(&done);
 
     switch(wakeupPin) {
         case LL_PWR_WAKEUP_PIN1:
-            playT1();
+            ret = playT1(repeatTimes, repeatDelay);
             break;
         case LL_PWR_WAKEUP_PIN4:
-            playT2();
+            ret = playT2(repeatTimes, repeatDelay);
             break;
         case LL_PWR_WAKEUP_PIN2:
-            playT3();
+            ret = playT3(repeatTimes, repeatDelay);
             break;
         case LL_PWR_WAKEUP_PIN5:
-            playT4();
+            ret = playT4(repeatTimes, repeatDelay);
             break;
 
         default:
             break;
     }
 
+    //nothing is playing, there is nothing to wait for
+    if (ret != 0) {
+        k_sem_give(&done);
+    }
+
     //disables the amplifier
 //    stm32dac_stop(dac);
+
+    return ret;
+}
+
+/**
+ * Waits for the signal to end
+ */
+bool GongPlayer::wait(k_timeout_t timeout)
+{
+    if (k_sem_take(&done, timeout) != 0) {
+        return false;
+    }
+
+    //the next wait returns at once as well
+    k_sem_give(&done);
+
+    return true;
+}
+
+/**
+ * Cancels the signal, it ends as soon as the DAC is stopped
+ */
+void GongPlayer::cancel()
+{
+    stm32dac_cancel(dac);
+}
+
+/**
+ * Sets up the DAC before the first signal
+ */
+void GongPlayer::prepare()
+{
+    const struct device *dac = DEVICE_DT_GET(DT_COMPAT_GET_ANY_STATUS_OKAY(st_stm32dac));
+
+    stm32dac_prepare(dac);
+}
+
+/**
+ * Called by the DAC driver thread when the signal has ended
+ */
+void GongPlayer::played(const struct device *dev, int result, void *userData)
+{
+    GongPlayer *player = static_cast<GongPlayer *>(userData);
+
+    LOG_INF("The signal has ended: %d", result);
+
+    k_sem_give(&player->done);
+}
+
+/**
+ * Plays the asset with the ID
+ */
+int GongPlayer::playAsset(uint16_t assetId, uint16_t playTimes, uint16_t playDelay)
+{
+#ifdef CONFIG_GONG_AUDIO_DIRECTORY
+    struct stm32dac_asset asset;
+
+    if (!GongAudio::get(assetId, &asset)) {
+        return -ENOENT;
+    }
+
+    //the driver copies the descriptor
+    return stm32dac_play_asset_async(dac, &asset, playTimes, playDelay, played, this);
+#else
+    //the descriptor has been validated and built at compile time
+    return stm32dac_play_asset_async(dac, &GongAudio::assets[assetId], playTimes, playDelay, played, this);
+#endif
 }
 
-void GongPlayer::playT1()
+int GongPlayer::playT1(uint16_t repeatTimes, uint16_t repeatDelay)
 {
-    printk("Playing T1 signal\n");
+    LOG_INF("Playing T1 signal");
 
-    stm32dac_play_audio(dac, GongAudio::threeSoundData, 1, 30);
+    return playAsset(GONG_AUDIO_THREE, repeatTimes, repeatDelay);
 }
 
-void GongPlayer::playT2()
+int GongPlayer::playT2(uint16_t repeatTimes, uint16_t repeatDelay)
 {
-    printk("Playing T2 signal\n");
+    LOG_INF("Playing T2 signal");
 
-    stm32dac_play_audio(dac, GongAudio::singleSoundData, 1, 30);
+    return playAsset(GONG_AUDIO_SINGLE, repeatTimes, repeatDelay);
 }
 
-void GongPlayer::playT3()
+int GongPlayer::playT3(uint16_t repeatTimes, uint16_t repeatDelay)
 {
-    printk("Playing T3 signal\n");
+    LOG_INF("Playing T3 signal");
 
-    stm32dac_play_audio(dac, GongAudio::singleSoundData, 1, 30);
+    return playAsset(GONG_AUDIO_SINGLE, repeatTimes, repeatDelay);
 }
 
-void GongPlayer::playT4()
+int GongPlayer::playT4(uint16_t repeatTimes, uint16_t repeatDelay)
 {
-    printk("Playing T4 signal\n");
+    LOG_INF("Playing T4 signal");
 
+    return -ENOENT;
 }
@@ -1,13 +1,16 @@
 #include <GongPm.h>
 
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(gong_pm, CONFIG_APP_LOG_LEVEL);
+
 GongPm::GongPm()
 {
 
-    printk("\nGet device stm32lpm\n");
+    LOG_DBG("Get device stm32lpm");
     pm = DEVICE_DT_GET(DT_COMPAT_GET_ANY_STATUS_OKAY(st_stm32pm));
     
     if (!pm) {
-        printk("Device STM32PM not found.\n");
+        LOG_ERR("Device STM32PM not found.");
         return;
     }
 
@@ -20,7 +23,7 @@ GongPm::GongPm()
 int32_t GongPm::getWakeupPin()
 {
     int wakeupPin = stm32pm_wakeup_pin_get(pm);
-    printk("wakeupPin: %d\n", wakeupPin);
+    LOG_DBG("wakeupPin: %d", wakeupPin);
 
     return wakeupPin;
 }
@@ -31,18 +34,95 @@ int32_t GongPm::getWakeupPin()
 int GongPm::isWakeupPinActive()
 {
     int isActive = stm32pm_wakeup_pin_active(pm);
-    printk("Is WakeupPin active: %d\n", isActive);
+    LOG_DBG("Is WakeupPin active: %d", isActive);
 
     return isActive;
 }
 
+/**
+ * Gets every wakeup pin that has awaken the system
+ */
+uint32_t GongPm::getWokenPins()
+{
+    struct stm32pm_wakeup_pins pins;
+    stm32pm_wakeup_pins_get(pm, &pins);
+    LOG_DBG("Woken pins: 0x%02lx", (unsigned long)pins.woken);
+
+    return pins.woken;
+}
+
+/**
+ * Gets the wakeup pins that are active now
+ */
+uint32_t GongPm::getActivePins()
+{
+    struct stm32pm_wakeup_pins pins;
+    stm32pm_wakeup_pins_get(pm, &pins);
+    LOG_DBG("Active pins: 0x%02lx", (unsigned long)pins.active);
+
+    return pins.active;
+}
+
+/**
+ * Gets how many wakes have been rejected as glitches since the power on
+ */
+uint32_t GongPm::getRejectedWakes()
+{
+    uint32_t rejected = stm32pm_rejected_wakes_get(pm);
+    LOG_DBG("Rejected wakes: %lu", (unsigned long)rejected);
+
+    return rejected;
+}
+
+/**
+ * Calls the callback when a wakeup pin is released
+ */
+int GongPm::onWakeupPinRelease(stm32pm_release_callback_t callback, void *userData)
+{
+    return stm32pm_wakeup_pin_release_callback_set(pm, callback, userData);
+}
+
+/**
+ * Gets why the system has started
+ */
+enum stm32pm_wake_cause GongPm::getWakeCause()
+{
+    enum stm32pm_wake_cause cause = stm32pm_wake_cause_get(pm);
+    LOG_DBG("Wake cause: %d", cause);
+
+    return cause;
+}
+
 
 /**
  * Puts the system into the standby mode
  */
 void GongPm::standby()
 {
-    stm32pm_state_set(pm, PM_STATE_STANDBY, 0);
+#ifdef CONFIG_GONG_PM_SHUTDOWN
+    stm32pm_state_set(pm, PM_STATE_STANDBY, STM32PM_SUBSTATE_SHUTDOWN);
+#else
+    stm32pm_state_set(pm, PM_STATE_STANDBY, STM32PM_SUBSTATE_STANDBY);
+#endif
+}
+
+/**
+ * Sleeps in the stop2 mode until an interrupt
+ */
+void GongPm::stop2()
+{
+    stm32pm_state_set(pm, PM_STATE_SUSPEND_TO_IDLE, STM32PM_SUBSTATE_STOP2);
+}
+
+/**
+ * Puts the system into the standby mode until the wakeup pin is released
+ */
+void GongPm::standbyUntilRelease(uint32_t timeoutSeconds)
+{
+    if (stm32pm_standby_until_release(pm, timeoutSeconds) != 0) {
+        //there is no pin to wait for
+        standby();
+    }
 }
 
 
@@ -8,14 +8,12 @@
 #include "app_version.h"
 
 #include <zephyr/logging/log.h>
-LOG_MODULE_REGISTER(main, LOG_LEVEL_INF);
+LOG_MODULE_REGISTER(main, CONFIG_APP_LOG_LEVEL);
 
 #include <zephyr/device.h>
 #include <zephyr/devicetree.h>
 #include <zephyr/drivers/gpio.h>
 
-#include <zephyr/sys/printk.h>
-
 #include <zephyr/pm/device.h>
 #include <zephyr/pm/state.h>
 
@@ -24,52 +22,95 @@ LOG_MODULE_REGISTER(main, LOG_LEVEL_INF);
 #include "GongPm.h"
 
 
+//the signal that is playing and the wakeup pin that has started it
+struct Signal {
+    GongPlayer player;
+    int32_t wakeupPin;
+};
+
+/**
+ * Cancels the signal from the GPIO interrupt when its wakeup pin is released
+ */
+static void wakeupPinReleased(const struct device *dev, int32_t wakeupPin, void *userData)
+{
+    Signal *signal = static_cast<Signal *>(userData);
+
+    if (wakeupPin == signal->wakeupPin) {
+        signal->player.cancel();
+    }
+}
+
+/**
+ * Plays the signal of the wakeup pin until it ends or the pin is released
+ */
+static void playSignal(GongPm &pm, int32_t wakeupPin, uint16_t repeatTimes, uint16_t repeatDelay)
+{
+    Signal signal;
+    signal.wakeupPin = wakeupPin;
+
+    //the driver thread plays the repeats and the pauses,
+    //the signal fades out as soon as the wakeup pin is released
+    if (signal.player.play(wakeupPin, repeatTimes, repeatDelay) != 0) {
+        return;
+    }
+
+    pm.onWakeupPinRelease(wakeupPinReleased, &signal);
+
+    //released before the callback has been set
+    if ((pm.getActivePins() & wakeupPin) == 0) {
+        signal.player.cancel();
+    }
+
+    signal.player.wait(K_FOREVER);
+    pm.onWakeupPinRelease(NULL, NULL);
+}
+
+
 int main(void)
 {
 
     //power management
     GongPm pm;
-    int wakeupPin = pm.getWakeupPin();
+
+    //every pin that has woken the microprocessor, several signals can come at once
+    //a release or the end of the silent wait is not a new signal, there are no pins then
+    uint32_t wokenPins = pm.getWokenPins();
+    enum stm32pm_wake_cause wakeCause = pm.getWakeCause();
+    LOG_INF("Rejected wakes: %lu", (unsigned long)pm.getRejectedWakes());
 
     //how many times to repeat the signal if it's active
     const uint8_t repeatTimes = 5;
+    //the pause between the repeats in milliseconds
+    const uint16_t repeatDelay = 500;
     //how many minutes to wait silently after a sound stops 
     //if a wakeup pin is still active
     const uint8_t waitSilentlyMinutes = 15;
 
-    //if the microprocessor has been awaken by a wakeup pin
-    if (wakeupPin >= 0) {
-        for (int i = 0; i < repeatTimes; i++) {
-            GongPlayer player;
-            player.play(wakeupPin);
-
-            if (pm.isWakeupPinActive() == 0) {
-                break;
-            }
-
-            printk("Repeated the sound\n");
-            
-            //still active, play again after a pause
-            k_msleep(500);
-        }
-
-        //don't play an annoying sound, just wait
-        for (int i = 0; i < waitSilentlyMinutes * 60; i++) {
-            if (pm.isWakeupPinActive() == 0) {
-                break;
-            }
-            
-            printk("A wakeup pin is active, wait seconds: %u\n", i);
-
-            //sleep for 1 second
-            k_msleep(1000);
-        }
+    //a signal is coming, the first play starts without setting the DAC up
+    if (wokenPins != 0) {
+        GongPlayer::prepare();
+    }
+
+    //play the signal of every wakeup pin, the first pin first
+    for (uint32_t pending = wokenPins; pending != 0; pending &= pending - 1) {
+        int32_t wakeupPin = pending & (~pending + 1);
+
+        playSignal(pm, wakeupPin, repeatTimes, repeatDelay);
+    }
+
+    if (wakeCause == STM32PM_WAKE_TIMEOUT) {
+        LOG_INF("The wakeup pins are still active after %u minutes", waitSilentlyMinutes);
     }
 
     //increase when you need to reprogram often
     //you can't reprogram a sleeping device
     k_msleep(100);
 
+    //don't play an annoying sound, sleep in the standby mode until a pin is released
+    if ((wakeCause != STM32PM_WAKE_TIMEOUT) && (pm.getActivePins() != 0)) {
+        pm.standbyUntilRelease(waitSilentlyMinutes * 60);
+    }
+
     pm.standby();
 
     return 0;
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2024 Farit N
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "adpcm.h"
+#include "convert.h"
+
+//the size of the block header: the first sample, the step index and a reserved byte
+#define ADPCM_HEADER_SIZE 4
+
+static const int16_t adpcm_step_table[89] = {
+  7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+  19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+  50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+  130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+  337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+  876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+  2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+  5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+  15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int8_t adpcm_index_table[16] = {
+  -1, -1, -1, -1, 2, 4, 6, 8,
+  -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+// The number of samples in a full block: the header sample plus two samples per byte
+static inline uint32_t adpcm_block_samples(uint16_t block_align) {
+  return (block_align - ADPCM_HEADER_SIZE) * 2 + 1;
+}
+
+uint32_t ADPCM_SampleCount(uint32_t data_length, uint16_t block_align) {
+  if (block_align <= ADPCM_HEADER_SIZE) {
+    return 0;
+  }
+
+  uint32_t samples = (data_length / block_align) * adpcm_block_samples(block_align);
+  uint32_t last_block = data_length % block_align;
+
+  if (last_block >= ADPCM_HEADER_SIZE) {
+    samples += adpcm_block_samples(last_block);
+  }
+
+  return samples;
+}
+
+void ADPCM_Init(ADPCMState* state, uint8_t const* data, uint16_t block_align) {
+  state->next = data;
+  state->block_align = block_align;
+  state->block_left = 0;
+  state->high_nibble = 0;
+  state->index = 0;
+  state->predictor = 0;
+}
+
+void ADPCM_Decode(ADPCMState* state, uint16_t* dst, uint32_t count) {
+  uint8_t const* p = state->next;
+  int32_t predictor = state->predictor;
+  int32_t index = state->index;
+  uint32_t block_left = state->block_left;
+  uint8_t high_nibble = state->high_nibble;
+
+  for (uint32_t i = 0; i < count; i++) {
+    if (block_left == 0) {
+      // A new block starts with the first sample as is
+      predictor = (int16_t)(p[0] | (p[1] << 8));
+      index = p[2];
+      if (index > 88) {
+        index = 88;
+      }
+      p += ADPCM_HEADER_SIZE;
+
+      block_left = adpcm_block_samples(state->block_align) - 1;
+      high_nibble = 0;
+
+      dst[i] = stm32ldac_dac_value(predictor);
+      continue;
+    }
+
+    uint8_t code;
+    if (high_nibble) {
+      code = *p >> 4;
+      p++;
+    } else {
+      code = *p & 0x0F;
+    }
+    high_nibble = !high_nibble;
+
+    int32_t step = adpcm_step_table[index];
+    int32_t diff = step >> 3;
+    if (code & 1) {
+      diff += step >> 2;
+    }
+    if (code & 2) {
+      diff += step >> 1;
+    }
+    if (code & 4) {
+      diff += step;
+    }
+
+    if (code & 8) {
+      predictor -= diff;
+      if (predictor < -32768) {
+        predictor = -32768;
+      }
+    } else {
+      predictor += diff;
+      if (predictor > 32767) {
+        predictor = 32767;
+      }
+    }
+
+    index += adpcm_index_table[code];
+    if (index < 0) {
+      index = 0;
+    } else if (index > 88) {
+      index = 88;
+    }
+
+    block_left--;
+    dst[i] = stm32ldac_dac_value(predictor);
+  }
+
+  state->next = p;
+  state->predictor = predictor;
+  state->index = index;
+  state->block_left = block_left;
+  state->high_nibble = high_nibble;
+}
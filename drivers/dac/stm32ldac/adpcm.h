@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2024 Farit N
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef STM32LDAC_ADPCM_H__
+#define STM32LDAC_ADPCM_H__
+
+#include <stdint.h>
+
+/**
+ * The state of the IMA ADPCM (DVI, WAV format 0x0011) mono decoder.
+ *
+ * The audio data consists of blocks of block_align bytes. Every block starts with a header:
+ * the first sample (16-bit), the step index (8-bit) and a reserved byte. 
+ * The rest of the block are 4-bit codes, the low nibble first.
+ */
+typedef struct ADPCMState_t {
+  // The next byte of the audio data
+  uint8_t const* next;
+
+  // The size of one block in bytes
+  uint16_t block_align;
+
+  // How many samples are left in the current block
+  uint16_t block_left;
+
+  // If the next code is in the high nibble of the current byte
+  uint8_t high_nibble;
+
+  // The index into the step table
+  int8_t index;
+
+  // The last decoded sample
+  int32_t predictor;
+} ADPCMState;
+
+// Returns the number of samples in IMA ADPCM audio data of data_length bytes.
+// The last block can be shorter than block_align.
+uint32_t ADPCM_SampleCount(uint32_t data_length, uint16_t block_align);
+
+// Starts decoding IMA ADPCM audio data from the first block
+void ADPCM_Init(ADPCMState* state, uint8_t const* data, uint16_t block_align);
+
+// Decodes the next count samples into 12-bit DAC values.
+// The caller must not ask for more samples than ADPCM_SampleCount has returned.
+void ADPCM_Decode(ADPCMState* state, uint16_t* dst, uint32_t count);
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2024 Farit N
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "convert.h"
+
+#include <string.h>
+
+//flips the sign bits of both 16-bit samples in a word
+#define SIGN_FLIP_2 0x80008000u
+//keeps 12 bits of both DAC values in a word after the shift
+#define DAC_MASK_2 0x0FFF0FFFu
+
+void stm32ldac_convert_ref(uint16_t *dst, uint8_t const *src, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        //combine the low and high bytes of a 16-bit wav sample
+        //values in a wav file are stored signed in the range -32768 to 32767
+        int16_t sample = src[0] | (src[1] << 8);
+        src += 2;
+
+        //the STM32 DAC is 12 bit, it can represent the values in the range 0-4095
+        dst[i] = stm32ldac_dac_value(sample);
+    }
+}
+
+/*
+ * Converts two samples packed in a word: the sign flip is one EOR for both halfwords.
+ * The word is shifted right by 4, the bits that the high sample shifts 
+ * into the low halfword are masked off, so the result is two packed DAC values.
+ */
+static inline uint32_t stm32ldac_convert_2(uint32_t samples)
+{
+    return ((samples ^ SIGN_FLIP_2) >> 4) & DAC_MASK_2;
+}
+
+void stm32ldac_convert(uint16_t *dst, uint8_t const *src, uint32_t count)
+{
+    uint32_t in[4];
+
+    //a sustain loop can end on an odd sample, the first sample aligns the output to a word
+    if ((((uintptr_t)dst & 2) != 0) && (count > 0)) {
+        stm32ldac_convert_ref(dst, src, 1);
+        dst++;
+        src += 2;
+        count--;
+    }
+
+    uint32_t *out = (uint32_t *)dst;
+
+    //8 samples, 4 words per iteration
+    while (count >= 8) {
+        //Cortex-M4 loads unaligned words, memcpy turns into plain loads
+        memcpy(in, src, sizeof(in));
+        src += sizeof(in);
+
+        out[0] = stm32ldac_convert_2(in[0]);
+        out[1] = stm32ldac_convert_2(in[1]);
+        out[2] = stm32ldac_convert_2(in[2]);
+        out[3] = stm32ldac_convert_2(in[3]);
+        out += 4;
+
+        count -= 8;
+    }
+
+    //pairs of samples left
+    while (count >= 2) {
+        memcpy(in, src, sizeof(uint32_t));
+        src += sizeof(uint32_t);
+
+        *out++ = stm32ldac_convert_2(in[0]);
+
+        count -= 2;
+    }
+
+    //the last odd sample
+    if (count > 0) {
+        stm32ldac_convert_ref((uint16_t *)out, src, count);
+    }
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2024 Farit N
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef STM32LDAC_CONVERT_H__
+#define STM32LDAC_CONVERT_H__
+
+#include <stdint.h>
+
+/**
+ * Converts one signed 16-bit sample into a 12-bit DAC value.
+ * Flipping the sign bit gives offset binary 0-65535, dividing it by 16 gives 0-4095.
+ */
+static inline uint16_t stm32ldac_dac_value(int32_t sample)
+{
+    return (uint16_t)(sample ^ 0x8000) >> 4;
+}
+
+/**
+ * Converts signed 16-bit little-endian WAV samples into 12-bit DAC values.
+ * The sign bit is flipped to get offset binary 0-65535, then the value is divided by 16.
+ *
+ * This is the plain reference version, one sample at a time.
+ *
+ * @param dst    The DAC values
+ * @param src    The WAV samples, 2 bytes each
+ * @param count  The number of samples
+ */
+void stm32ldac_convert_ref(uint16_t *dst, uint8_t const *src, uint32_t count);
+
+/**
+ * Converts signed 16-bit little-endian WAV samples into 12-bit DAC values.
+ * Gives exactly the same values as stm32ldac_convert_ref, but it converts 
+ * two samples in each 32-bit word at a time.
+ *
+ * @param dst    The DAC values, must be 2-byte aligned
+ * @param src    The WAV samples, 2 bytes each, must be 2-byte aligned
+ * @param count  The number of samples
+ */
+void stm32ldac_convert(uint16_t *dst, uint8_t const *src, uint32_t count);
+
+#endif
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2024 Farit N
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "g711.h"
+#include "wave.h"
+#include "convert.h"
+
+//the bias added to the magnitude before mu-law compression
+#define MULAW_BIAS 0x84
+
+// Expands a mu-law code into a 16-bit sample
+static int32_t g711_mulaw_expand(uint8_t code) {
+  code = ~code;
+
+  int32_t exponent = (code >> 4) & 0x07;
+  int32_t magnitude = ((((code & 0x0F) << 3) + MULAW_BIAS) << exponent) - MULAW_BIAS;
+
+  return (code & 0x80) ? -magnitude : magnitude;
+}
+
+// Expands an A-law code into a 16-bit sample
+static int32_t g711_alaw_expand(uint8_t code) {
+  code ^= 0x55;
+
+  int32_t exponent = (code >> 4) & 0x07;
+  int32_t magnitude = ((code & 0x0F) << 4) + 8;
+  if (exponent > 0) {
+    magnitude = (magnitude + 0x100) << (exponent - 1);
+  }
+
+  // the sign bit set means a positive sample in A-law
+  return (code & 0x80) ? magnitude : -magnitude;
+}
+
+void G711_BuildTable(uint16_t* table, uint16_t format) {
+  for (uint32_t code = 0; code < G711_TABLE_SIZE; code++) {
+    int32_t sample = (format == WAV_FORMAT_ALAW) ? g711_alaw_expand(code) : g711_mulaw_expand(code);
+
+    table[code] = stm32ldac_dac_value(sample);
+  }
+}
+
+void G711_Decode(const uint16_t* table, uint8_t const* src, uint16_t* dst, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    dst[i] = table[src[i]];
+  }
+}
@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2024 Farit N
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef STM32LDAC_G711_H__
+#define STM32LDAC_G711_H__
+
+#include <stdint.h>
+
+// The number of 8-bit G.711 codes
+#define G711_TABLE_SIZE 256
+
+// Fills the table that expands 8-bit G.711 codes into 12-bit DAC values.
+// The format is WAV_FORMAT_MULAW or WAV_FORMAT_ALAW.
+void G711_BuildTable(uint16_t* table, uint16_t format);
+
+// Expands count 8-bit G.711 codes into 12-bit DAC values, one table load per sample
+void G711_Decode(const uint16_t* table, uint8_t const* src, uint16_t* dst, uint32_t count);
+
+#endif
@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2024 Farit N
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "lossless.h"
+#include "convert.h"
+
+// Reads whole bytes into the bit buffer until it has more than 24 bits.
+// After the end of the data zero bytes are read ahead, they are counted in padding.
+static inline void lossless_refill(LosslessState* state) {
+  while (state->bit_count <= 24) {
+    if (state->next < state->end) {
+      state->bits |= (uint32_t)(*state->next) << (24 - state->bit_count);
+      state->next++;
+    } else {
+      state->padding++;
+    }
+    state->bit_count += 8;
+  }
+}
+
+// Some bits after the end of the data have been used
+static inline int lossless_overrun(const LosslessState* state) {
+  return state->padding * 8 > state->bit_count;
+}
+
+// Drops n bits, 1-32, from the bit buffer
+static inline void lossless_skip(LosslessState* state, uint8_t n) {
+  state->bits = (n < 32) ? (state->bits << n) : 0;
+  state->bit_count -= n;
+}
+
+// Reads n bits, 1-24, MSB first
+static inline uint32_t lossless_read(LosslessState* state, uint8_t n) {
+  lossless_refill(state);
+
+  uint32_t value = state->bits >> (32 - n);
+  lossless_skip(state, n);
+
+  return value;
+}
+
+// Reads a unary number: the zeros before a one.
+// Returns -1 if the run is longer than max_unary or goes past the end of the data.
+static inline int32_t lossless_read_unary(LosslessState* state) {
+  uint32_t zeros = 0;
+
+  lossless_refill(state);
+
+  // all the valid bits are zeros, the invalid ones are always zeros too
+  while (state->bits == 0) {
+    zeros += state->bit_count;
+    state->bit_count = 0;
+    if ((zeros > state->max_unary) || lossless_overrun(state)) {
+      return -1;
+    }
+    lossless_refill(state);
+  }
+
+  uint8_t leading = __builtin_clz(state->bits);
+  zeros += leading;
+  lossless_skip(state, leading + 1);
+
+  if (zeros > state->max_unary) {
+    return -1;
+  }
+
+  return zeros;
+}
+
+// Starts the next frame: reads the predictor order and the Rice parameter.
+// Returns -1 if they are out of range.
+static int lossless_start_frame(LosslessState* state) {
+  state->order = lossless_read(state, 8);
+  state->rice = lossless_read(state, 8);
+
+  if ((state->order > LOSSLESS_MAX_ORDER)
+      || ((state->rice > LOSSLESS_MAX_RICE) && (state->rice != LOSSLESS_VERBATIM))) {
+    return -1;
+  }
+
+  // the encoder stores a frame as is if the residuals take more bits than that,
+  // and the residual itself can't be larger than the limit
+  state->max_unary = 16u * state->frame_size;
+  if ((state->rice != LOSSLESS_VERBATIM)
+      && (state->max_unary > (LOSSLESS_RESIDUAL_LIMIT >> state->rice))) {
+    state->max_unary = LOSSLESS_RESIDUAL_LIMIT >> state->rice;
+  }
+
+  state->warmup_left = state->order;
+  state->frame_left = (state->left < state->frame_size) ? state->left : state->frame_size;
+
+  return 0;
+}
+
+// Finishes the frame: the next frame starts on the next byte boundary,
+// the whole bytes that have been read ahead belong to it.
+// The zero bytes read after the end of the data are the last ones read ahead.
+static void lossless_end_frame(LosslessState* state) {
+  uint32_t ahead = state->bit_count / 8;
+
+  if (ahead > state->padding) {
+    state->next -= ahead - state->padding;
+  }
+  state->padding = 0;
+  state->bits = 0;
+  state->bit_count = 0;
+}
+
+// Predicts the next sample from the history with the fixed predictor of the order
+static inline int32_t lossless_predict(const int32_t* h, uint8_t order) {
+  switch (order) {
+    case 1:
+      return h[0];
+    case 2:
+      return 2 * h[0] - h[1];
+    case 3:
+      return 3 * h[0] - 3 * h[1] + h[2];
+    case 4:
+      return 4 * h[0] - 6 * h[1] + 4 * h[2] - h[3];
+    default:
+      return 0;
+  }
+}
+
+void LOSSLESS_Init(LosslessState* state, uint8_t const* data, uint32_t size,
+                   uint16_t frame_size, uint32_t sample_count) {
+  state->next = data;
+  state->end = data + size;
+  state->padding = 0;
+  state->bits = 0;
+  state->bit_count = 0;
+  state->order = 0;
+  state->rice = 0;
+  state->max_unary = 0;
+  state->warmup_left = 0;
+  state->frame_size = frame_size;
+  state->frame_left = 0;
+  state->left = sample_count;
+
+  for (int i = 0; i < LOSSLESS_MAX_ORDER; i++) {
+    state->history[i] = 0;
+  }
+}
+
+// Fills the rest of the samples with silence after corrupt data, the decoding stops
+static int lossless_fail(LosslessState* state, uint16_t* dst, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    dst[i] = stm32ldac_dac_value(0);
+  }
+  state->left = 0;
+  state->frame_left = 0;
+
+  return -1;
+}
+
+int LOSSLESS_Decode(LosslessState* state, uint16_t* dst, uint32_t count) {
+  int32_t* h = state->history;
+
+  for (uint32_t i = 0; i < count; i++) {
+    if ((state->frame_left == 0) && (lossless_start_frame(state) != 0)) {
+      return lossless_fail(state, dst + i, count - i);
+    }
+
+    int32_t sample;
+
+    if ((state->rice == LOSSLESS_VERBATIM) || (state->warmup_left > 0)) {
+      // the sample is stored as is
+      sample = (int16_t)lossless_read(state, 16);
+      if (state->warmup_left > 0) {
+        state->warmup_left--;
+      }
+    } else {
+      int32_t zeros = lossless_read_unary(state);
+      if (zeros < 0) {
+        return lossless_fail(state, dst + i, count - i);
+      }
+
+      uint32_t value = (uint32_t)zeros << state->rice;
+      if (state->rice > 0) {
+        value |= lossless_read(state, state->rice);
+      }
+
+      // zigzag back to signed
+      int32_t residual = (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+      sample = lossless_predict(h, state->order) + residual;
+
+      if ((sample < INT16_MIN) || (sample > INT16_MAX)) {
+        return lossless_fail(state, dst + i, count - i);
+      }
+    }
+
+    if (lossless_overrun(state)) {
+      return lossless_fail(state, dst + i, count - i);
+    }
+
+    h[3] = h[2];
+    h[2] = h[1];
+    h[1] = h[0];
+    h[0] = sample;
+
+    dst[i] = stm32ldac_dac_value(sample);
+
+    state->left--;
+    state->frame_left--;
+    if (state->frame_left == 0) {
+      lossless_end_frame(state);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2024 Farit N
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef STM32LDAC_LOSSLESS_H__
+#define STM32LDAC_LOSSLESS_H__
+
+#include <stdint.h>
+
+/*
+ * The lossless format (WAV_FORMAT_LOSSLESS) is a FLAC-like bit stream of frames.
+ * Every frame has block_align samples (the last one can be shorter), it starts on a byte
+ * boundary and can be decoded without the previous frames. A frame consists of:
+ *
+ *   8 bits   the order of the fixed linear predictor, 0-4
+ *   8 bits   the Rice parameter, 0-15, or LOSSLESS_VERBATIM
+ *   16 bits  per warm-up sample, as many as the order, signed
+ *   the Rice-coded residuals of the rest of the samples: the high part in unary
+ *            (zeros ended by a one), then the low part in Rice parameter bits.
+ *            The residuals are zigzag mapped to unsigned: 0, -1, 1, -2, 2...
+ *
+ * A verbatim frame has all samples as signed 16-bit values.
+ * The bits are stored MSB first, the last byte of a frame is padded with zeros.
+ */
+
+// The Rice parameter that marks a frame with samples stored as is
+#define LOSSLESS_VERBATIM 0xFF
+
+// The maximum order of the fixed linear predictor
+#define LOSSLESS_MAX_ORDER 4
+
+// The maximum Rice parameter of a coded frame
+#define LOSSLESS_MAX_RICE 15
+
+// The zigzag mapped residuals of 16-bit samples are less than this with any order
+#define LOSSLESS_RESIDUAL_LIMIT (1u << 21)
+
+// The state of the lossless decoder
+typedef struct LosslessState_t {
+  // The next byte of the bit stream
+  uint8_t const* next;
+
+  // The end of the bit stream, the decoder doesn't read from it
+  uint8_t const* end;
+
+  // How many zero bytes have been read ahead after the end
+  uint32_t padding;
+
+  // The bits read ahead, MSB first
+  uint32_t bits;
+
+  // How many bits in bits are valid
+  uint8_t bit_count;
+
+  // The order of the predictor in the current frame
+  uint8_t order;
+
+  // The Rice parameter in the current frame
+  uint8_t rice;
+
+  // The longest unary run that can be valid in the current frame
+  uint32_t max_unary;
+
+  // How many warm-up samples of the current frame are left
+  uint8_t warmup_left;
+
+  // The number of samples in a frame
+  uint16_t frame_size;
+
+  // How many samples are left in the current frame
+  uint16_t frame_left;
+
+  // How many samples are left in the audio
+  uint32_t left;
+
+  // The last decoded samples, history[0] is the newest one
+  int32_t history[LOSSLESS_MAX_ORDER];
+} LosslessState;
+
+// Starts decoding the lossless audio data of sample_count samples from the first frame,
+// the data is size bytes long
+void LOSSLESS_Init(LosslessState* state, uint8_t const* data, uint32_t size,
+                   uint16_t frame_size, uint32_t sample_count);
+
+// Decodes the next count samples into 12-bit DAC values.
+// The caller must not ask for more samples than there are left.
+// Returns 0, or -1 if the data is corrupt: a frame header out of range, a unary run
+// longer than a frame can have, a sample out of the 16-bit range or the end of the data
+// reached before the samples. The rest of dst is then filled with silence.
+int LOSSLESS_Decode(LosslessState* state, uint16_t* dst, uint32_t count);
+
+#endif
@@ -6,12 +6,17 @@
 
 #include "stm32ldac.h"
 
-//the flag that is set in the transfer complete interrupt
-uint8_t dma_complete;
-//2 buffers, fill one buffer, then send it to DAC
-//after sending the first buffer, start filling the second one
-//switch the buffers when the interrupt DMA_Complete fires
-uint16_t dma_buffer[2][BUFFERSIZE];
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(stm32ldac, CONFIG_STM32LDAC_LOG_LEVEL);
+
+static void stm32ldac_thread(void *p1, void *p2, void *p3);
+
+//2 buffers that DMA sends to DAC in the circular mode without stopping
+//while DMA sends one buffer, fill the other one
+//the half transfer interrupt frees the first buffer, the transfer complete interrupt frees the second one
+uint16_t dma_buffer[2][BUFFERSIZE] __aligned(4);
+//expands 8-bit G.711 codes into 12-bit DAC values, it's built for mu-law or A-law before a play
+uint16_t g711_table[G711_TABLE_SIZE];
 
 
 /*
@@ -22,17 +27,17 @@ static int stm32ldac_init_enable_gpio(const struct device *dev)
     struct stm32ldac_config *config = (struct stm32ldac_config *)dev->config;
     int ret = 0;
 
-    printk("Configuring the amplifier enable pin\n");
+    LOG_DBG("Configuring the amplifier enable pin");
 
     if (!gpio_is_ready_dt(&config->enable_gpio)) {
-        printk("Error: enable device %d is not ready\n", config->enable_gpio.pin);
+        LOG_ERR("enable device %d is not ready", config->enable_gpio.pin);
         return 1;
     }
 
     ret = gpio_pin_configure_dt(&config->enable_gpio, GPIO_OUTPUT_INACTIVE | GPIO_ACTIVE_HIGH);
 
     if (ret != 0) {
-        printk("Error: failed to configure %s pin %d, error: %d\n",  
+        LOG_ERR("failed to configure %s pin %d, error: %d",  
             config->enable_gpio.port->name, config->enable_gpio.pin, ret);
         return 1;
     }
@@ -48,16 +53,16 @@ static int stm32ldac_enable_enable_gpio(const struct device *dev)
     struct stm32ldac_config *config = (struct stm32ldac_config *)dev->config;
     int ret = 0;
 
-    printk("Enables the amplifier enable pin\n");
+    LOG_DBG("Enables the amplifier enable pin");
 
     if (!gpio_is_ready_dt(&config->enable_gpio)) {
-        printk("Error: enable device %d is not ready\n", config->enable_gpio.pin);
+        LOG_ERR("enable device %d is not ready", config->enable_gpio.pin);
         return 1;
     }
 
     ret = gpio_pin_set_dt(&config->enable_gpio, 1);
     if (ret != 0) {
-        printk("Error: enable device %d cannot be set, error: %d\n", config->enable_gpio.pin, ret);
+        LOG_ERR("enable device %d cannot be set, error: %d", config->enable_gpio.pin, ret);
         return 1;
     }
 
@@ -72,38 +77,459 @@ static int stm32ldac_disable_enable_gpio(const struct device *dev)
     struct stm32ldac_config *config = (struct stm32ldac_config *)dev->config;
     int ret = 0;
 
-    printk("Disables the amplifier enable pin\n");
+    LOG_DBG("Disables the amplifier enable pin");
 
     if (!gpio_is_ready_dt(&config->enable_gpio)) {
-        printk("Error: enable device %d is not ready\n", config->enable_gpio.pin);
+        LOG_ERR("enable device %d is not ready", config->enable_gpio.pin);
         return 1;
     }
 
     ret = gpio_pin_set_dt(&config->enable_gpio, 0);
     if (ret != 0) {
-        printk("Error: disable device %d cannot be set, error: %d\n", config->enable_gpio.pin, ret);
+        LOG_ERR("disable device %d cannot be set, error: %d", config->enable_gpio.pin, ret);
         return 1;
     }
 
     return 0;
 }
 
+/**
+ * Starts DMA on the next segment of DAC-native audio data in the flash.
+ * DMA can send at most 65535 items in one go, longer audio is split into segments.
+ */
+static void stm32ldac_start_segment(struct stm32ldac_data *data)
+{
+    uint32_t segment = (data->direct_left <= DMA_MAX_ITEMS) ? data->direct_left : DMA_MAX_ITEMS;
+
+    //Disable the DMA channel to configure it
+    LL_DMA_DisableChannel(DMA1, LL_DMA_CHANNEL_3);
+
+    if (data->direct_silent) {
+        //the memory address doesn't move, DMA sends the same silence value on every timer tick
+        LL_DMA_SetMemoryIncMode(DMA1, LL_DMA_CHANNEL_3, LL_DMA_MEMORY_NOINCREMENT);
+        LL_DMA_SetMemoryAddress(DMA1, LL_DMA_CHANNEL_3, (uint32_t)&data->direct_silence);
+    } else {
+        LL_DMA_SetMemoryIncMode(DMA1, LL_DMA_CHANNEL_3, LL_DMA_MEMORY_INCREMENT);
+        LL_DMA_SetMemoryAddress(DMA1, LL_DMA_CHANNEL_3, (uint32_t)data->direct_next);
+        data->direct_next += segment * data->sample_size;
+    }
+
+    LL_DMA_SetDataLength(DMA1, LL_DMA_CHANNEL_3, segment);
+
+    LL_DMA_EnableChannel(DMA1, LL_DMA_CHANNEL_3);
+
+    data->direct_left -= segment;
+}
+
+/**
+ * Starts sending the DAC-native audio from its beginning, up to the end of the loop 
+ * if there is one. The DMA interrupt sends the rest.
+ */
+static void stm32ldac_direct_restart(struct stm32ldac_data *data)
+{
+    data->direct_silent = false;
+    data->direct_next = data->audio;
+    data->direct_left = data->samples;
+    data->direct_loops_left = data->loop_repeats;
+    data->direct_tail_left = 0;
+
+    if (data->loop_repeats > 0) {
+        data->direct_loop = data->audio + data->loop_start * data->sample_size;
+        data->direct_left = data->loop_end;
+        data->direct_tail_left = data->samples - data->loop_end;
+    }
+
+    //the silence before the next play
+    data->gap_left = (data->repeats_left > 0) ? data->gap_samples : 0;
+}
+
+/**
+ * Finds what DMA sends when the current part has been sent: the loop again, 
+ * the rest of the audio after the loop, the silence between plays or the next play
+ *
+ * @return false if the whole sequence has been sent
+ */
+static bool stm32ldac_direct_next_part(struct stm32ldac_data *data)
+{
+    if (data->direct_left > 0) {
+        return true;
+    }
+
+    if (data->direct_loops_left > 0) {
+        //send the loop again
+        data->direct_loops_left--;
+        data->direct_next = data->direct_loop;
+        data->direct_left = data->loop_end - data->loop_start;
+    } else if (data->direct_tail_left > 0) {
+        //the loop is over, send the rest of the audio after it
+        data->direct_next = data->direct_loop + (data->loop_end - data->loop_start) * data->sample_size;
+        data->direct_left = data->direct_tail_left;
+        data->direct_tail_left = 0;
+    } else if (data->gap_left > 0) {
+        //the timer keeps running, DMA sends silence until the next play
+        data->direct_silent = true;
+        data->direct_left = data->gap_left;
+        data->gap_left = 0;
+    } else if (data->repeats_left > 0) {
+        data->repeats_left--;
+        stm32ldac_direct_restart(data);
+    } else {
+        return false;
+    }
+
+    return data->direct_left > 0;
+}
+
 /**
  * DMA interrupt handler 
  */
 static void stm32ldac_irq_handler(const struct device *dev)
 {
-    ARG_UNUSED(dev);
+    struct stm32ldac_data *data = (struct stm32ldac_data *)dev->data;
+
+#ifdef CONFIG_STM32LDAC_CYCLE_STATS
+    //TIM6 counts at the CPU clock from the tick that has made DMA send the last item,
+    //valid while the latency is shorter than one sample
+    uint32_t latency = LL_TIM_GetCounter(TIM6);
+
+    data->irq_latency_total += latency;
+    data->irq_latency_max = MAX(data->irq_latency_max, latency);
+    data->irq_count++;
+#endif
+
+    //in the direct mode DMA reads the audio straight from the flash in segments
+    if (data->direct) {
+        if (LL_DMA_IsActiveFlag_TC3(DMA1) == 1) {
+            // Clear flag DMA transfer complete
+            LL_DMA_ClearFlag_TC3(DMA1);
+
+            if (stm32ldac_direct_next_part(data)) {
+                //chain the next segment before the next timer tick
+                stm32ldac_start_segment(data);
+            } else {
+                //the last segment of the last play has been sent
+                k_sem_give(&data->dma_sem);
+            }
+        }
+
+        return;
+    }
+
+    //the buffers are always sent in the same order, first then second,
+    //so the waiting thread knows which buffer has been freed by counting the semaphore
+    if (LL_DMA_IsActiveFlag_HT3(DMA1) == 1) {
+        // Clear flag DMA half transfer
+        LL_DMA_ClearFlag_HT3(DMA1);
+
+        //the first buffer has been sent, DMA continues with the second one
+        k_sem_give(&data->dma_sem);
+    }
 
     if (LL_DMA_IsActiveFlag_TC3(DMA1) == 1) {
         // Clear flag DMA transfer complete
         LL_DMA_ClearFlag_TC3(DMA1);
         
-        dma_complete = 1;
+        //the second buffer has been sent, DMA wraps around to the first one
+        k_sem_give(&data->dma_sem);
+    }
+}
+
+#ifdef CONFIG_STM32LDAC_DIRECT_ISR
+/**
+ * DMA interrupt, it goes to the handler without the common interrupt wrapper
+ */
+ISR_DIRECT_DECLARE(stm32ldac_dma_isr)
+{
+    stm32ldac_irq_handler(DEVICE_DT_INST_GET(0));
+
+    ISR_DIRECT_PM();
+
+    //the handler gives the semaphore the playing thread waits on
+    return 1;
+}
+#endif
+
+/**
+ * Starts decoding the audio data from the beginning
+ *
+ * @param stream       The stream with the audio format set
+ * @param audio        The audio data
+ * @param length       The length of the audio data in bytes
+ * @param samples      The number of samples in the audio data
+ * @param block_align  The size of a compressed block in bytes (IMA ADPCM) or samples (lossless)
+ */
+static void stm32ldac_stream_init(struct stm32ldac_stream *stream, const uint8_t* audio, 
+    uint32_t length, uint32_t samples, uint16_t block_align)
+{
+    stream->next = audio;
+    stream->left = samples;
+    stream->position = 0;
+
+    if (stream->format == WAV_FORMAT_IMA_ADPCM) {
+        ADPCM_Init(&stream->adpcm, audio, block_align);
+    } else if (stream->format == WAV_FORMAT_LOSSLESS) {
+        LOSSLESS_Init(&stream->lossless, audio, length, block_align, samples);
+    }
+}
+
+/**
+ * Decodes the next samples of the stream into 12-bit DAC values
+ *
+ * @param stream  The stream
+ * @param dst     The DAC values
+ * @param count   The number of samples, not more than the samples left
+ *
+ * @retval 0         On success.
+ * @retval -EBADMSG  If the audio data is corrupt, the rest of the samples are silence.
+ */
+static int stm32ldac_stream_read(struct stm32ldac_stream *stream, uint16_t *dst, uint32_t count)
+{
+    int ret = 0;
+
+    switch (stream->format) {
+        case WAV_FORMAT_IMA_ADPCM:
+            //decode 4-bit codes straight into the DMA buffer
+            ADPCM_Decode(&stream->adpcm, dst, count);
+            break;
+
+        case WAV_FORMAT_MULAW:
+        case WAV_FORMAT_ALAW:
+            //one table load per sample
+            G711_Decode(g711_table, stream->next, dst, count);
+            stream->next += count;
+            break;
+
+        case WAV_FORMAT_LOSSLESS:
+            //decode the predictor residuals straight into the DMA buffer
+            if (LOSSLESS_Decode(&stream->lossless, dst, count) != 0) {
+                ret = -EBADMSG;
+            }
+            break;
+
+        default:
+            //convert 16-bit wav samples into 12-bit DAC values
+#ifdef CONFIG_STM32LDAC_CONVERT_WORDS
+            stm32ldac_convert(dst, stream->next, count);
+#else
+            stm32ldac_convert_ref(dst, stream->next, count);
+#endif
+            stream->next += count * 2;
+            break;
     }
+
+    stream->left -= count;
+    stream->position += count;
+
+    return ret;
 }
 
+/**
+ * Decodes the next samples of the stream into 12-bit DAC values, playing the sustain loop 
+ * as many times as it's left. The decoder state is saved at the start of the loop 
+ * and restored at its end, so the loop is sample exact for every format.
+ *
+ * @param data   The driver data with the stream to decode
+ * @param dst    The DAC values
+ * @param count  The maximum number of samples
+ *
+ * @return The number of samples decoded, less than count at the end of the audio
+ */
+static uint32_t stm32ldac_stream_read_looped(struct stm32ldac_data *data, uint16_t *dst, uint32_t count)
+{
+    struct stm32ldac_stream *stream = &data->stream;
+    uint32_t done = 0;
+
+    while ((done < count) && (stream->left > 0)) {
+        uint32_t n = count - done;
+
+        if (n > stream->left) {
+            n = stream->left;
+        }
 
+        if (data->loops_left > 0) {
+            if (stream->position == data->loop_start) {
+                data->loop_stream = *stream;
+            }
+
+            //stop at the start and the end of the loop
+            uint32_t boundary = (stream->position < data->loop_start) ? data->loop_start : data->loop_end;
+            if (n > boundary - stream->position) {
+                n = boundary - stream->position;
+            }
+        }
+
+        if (stm32ldac_stream_read(stream, dst + done, n) != 0) {
+            //the sequence ends with the silence the decoder has filled in
+            data->corrupt = true;
+            stream->left = 0;
+            data->loops_left = 0;
+            data->gap_left = 0;
+            data->repeats_left = 0;
+
+            return done + n;
+        }
+        done += n;
+
+        if ((data->loops_left > 0) && (stream->position == data->loop_end)) {
+            //decode the loop again from its start
+            data->loops_left--;
+            *stream = data->loop_stream;
+        }
+    }
+
+    return done;
+}
+
+/**
+ * Starts decoding the audio from its beginning for the next play
+ */
+static void stm32ldac_stream_restart(struct stm32ldac_data *data)
+{
+    stm32ldac_stream_init(&data->stream, data->audio, data->length, data->samples, data->block_align);
+    data->loops_left = data->loop_repeats;
+
+    //the silence before the next play
+    data->gap_left = (data->repeats_left > 0) ? data->gap_samples : 0;
+}
+
+/**
+ * Decodes the next samples of the sequence into 12-bit DAC values: the plays of the audio
+ * with the silence between them
+ *
+ * @param data   The driver data with the stream to decode
+ * @param dst    The DAC values
+ * @param count  The maximum number of samples
+ *
+ * @return The number of samples decoded, less than count at the end of the sequence
+ */
+static uint32_t stm32ldac_sequence_read(struct stm32ldac_data *data, uint16_t *dst, uint32_t count)
+{
+    uint32_t done = 0;
+
+    while (done < count) {
+        if (data->stream.left > 0) {
+            done += stm32ldac_stream_read_looped(data, dst + done, count - done);
+        } else if (data->gap_left > 0) {
+            //the silence between plays, the timer keeps running
+            uint32_t n = (data->gap_left < count - done) ? data->gap_left : count - done;
+
+            for (uint32_t i = 0; i < n; i++) {
+                dst[done + i] = DAC_SILENCE;
+            }
+
+            data->gap_left -= n;
+            done += n;
+        } else if (data->repeats_left > 0) {
+            //the next play starts on the sample right after the silence
+            data->repeats_left--;
+            stm32ldac_stream_restart(data);
+        } else {
+            break;
+        }
+    }
+
+    return done;
+}
+
+/**
+ * Fills one half of the DMA buffer with the next block of the stream
+ * decoded into 12-bit DAC values. If there are less samples than the buffer size,
+ * the rest of the buffer is filled with silence.
+ *
+ * @param data  The driver data with the stream to decode
+ * @param bank  The buffer half to fill
+ */
+static void stm32ldac_fill_bank(struct stm32ldac_data *data, uint8_t bank)
+{
+#ifdef CONFIG_STM32LDAC_CYCLE_STATS
+    uint32_t start = k_cycle_get_32();
+#endif
+
+    //the last audio chunk can be smaller than the buffer size
+    uint32_t block_size = stm32ldac_sequence_read(data, dma_buffer[bank], BUFFERSIZE);
+
+#ifdef CONFIG_STM32LDAC_CYCLE_STATS
+    if (block_size > 0) {
+        uint32_t cycles = k_cycle_get_32() - start;
+
+        data->fill_cycles_total += cycles;
+        data->fill_blocks++;
+        if (cycles > data->fill_cycles_max) {
+            data->fill_cycles_max = cycles;
+        }
+    }
+#endif
+
+    //DMA keeps running in the circular mode, so send silence after the audio ends
+    for (uint32_t i = block_size; i < BUFFERSIZE; i++) {
+        dma_buffer[bank][i] = DAC_SILENCE;
+    }
+}
+
+
+
+/**
+ * Stops DMA after a play, the DAC keeps the last value
+ */
+static void stm32ldac_stop_dma(void)
+{
+    LL_DAC_DisableDMAReq(DAC1, LL_DAC_CHANNEL_1);
+    LL_DMA_DisableChannel(DMA1, LL_DMA_CHANNEL_3);
+    LL_DAC_ClearFlag_DMAUDR1(DAC1);
+}
+
+/**
+ * Ramps the DAC output from its last value to the middle of the range after a cancelled play,
+ * so the speaker doesn't pop, and disables the amplifier.
+ * DMA sends the ramp at the sample rate of the play, the timer is still running.
+ */
+static void stm32ldac_fade_out(const struct device *dev)
+{
+    struct stm32ldac_data *data = (struct stm32ldac_data *)dev->data;
+
+    if (LL_DAC_IsEnabled(DAC1, LL_DAC_CHANNEL_1) != 0) {
+        //the ramp fits into the first half of the DMA buffer
+        uint32_t samples = (data->sample_rate * CONFIG_STM32LDAC_FADE_OUT_MS) / 1000;
+        samples = CLAMP(samples, 1, BUFFERSIZE);
+
+        int32_t from = LL_DAC_RetrieveOutputData(DAC1, LL_DAC_CHANNEL_1);
+
+        for (uint32_t i = 0; i < samples; i++) {
+            dma_buffer[0][i] = from + ((DAC_SILENCE - from) * (int32_t)(i + 1)) / (int32_t)samples;
+        }
+
+        k_sem_reset(&data->dma_sem);
+        LL_DMA_ClearFlag_HT3(DMA1);
+        LL_DMA_ClearFlag_TC3(DMA1);
+
+        //the ramp is sent once, the transfer complete interrupt gives the semaphore
+        LL_DMA_DisableIT_HT(DMA1, LL_DMA_CHANNEL_3);
+        LL_DMA_SetMode(DMA1, LL_DMA_CHANNEL_3, LL_DMA_MODE_NORMAL);
+        LL_DMA_SetPeriphSize(DMA1, LL_DMA_CHANNEL_3, LL_DMA_PDATAALIGN_HALFWORD);
+        LL_DMA_SetMemorySize(DMA1, LL_DMA_CHANNEL_3, LL_DMA_MDATAALIGN_HALFWORD);
+        LL_DMA_SetMemoryIncMode(DMA1, LL_DMA_CHANNEL_3, LL_DMA_MEMORY_INCREMENT);
+        LL_DMA_ConfigAddresses(DMA1,
+            LL_DMA_CHANNEL_3,
+            (uint32_t)dma_buffer[0],
+            LL_DAC_DMA_GetRegAddr(DAC1, LL_DAC_CHANNEL_1, LL_DAC_DMA_REG_DATA_12BITS_RIGHT_ALIGNED),
+            LL_DMA_DIRECTION_MEMORY_TO_PERIPH);
+        LL_DMA_SetDataLength(DMA1, LL_DMA_CHANNEL_3, samples);
+
+        LL_DMA_EnableChannel(DMA1, LL_DMA_CHANNEL_3);
+        LL_DAC_EnableDMAReq(DAC1, LL_DAC_CHANNEL_1);
+
+        k_timeout_t timeout = K_MSEC((samples * 1000) / data->sample_rate + DMA_TIMEOUT_MARGIN_MS);
+
+        if (k_sem_take(&data->dma_sem, timeout) != 0) {
+            LOG_ERR("DMA has stalled during the fade out");
+        }
+
+        stm32ldac_stop_dma();
+    }
+
+    //the output is at the middle of the range, the amplifier can be switched off without a pop
+    stm32ldac_disable_enable_gpio(dev);
+}
 
 /**
  * Stops
@@ -111,7 +537,12 @@ static void stm32ldac_irq_handler(const struct device *dev)
  */
 static int stm32ldac_stop(const struct device *dev)
 {
-    ARG_UNUSED(dev);
+    struct stm32ldac_data *data = (struct stm32ldac_data *)dev->data;
+
+    //nothing has been played, the peripherals are still off
+    if (!data->ready) {
+        return 0;
+    }
 
     stm32ldac_disable_enable_gpio(dev);
 
@@ -121,7 +552,8 @@ static int stm32ldac_stop(const struct device *dev)
     // Disable DAC channel
     LL_DAC_Disable(DAC1, LL_DAC_CHANNEL_1);
 
-    // Disable DMA transfer interruption: transfer complete
+    // Disable DMA transfer interruptions: half transfer and transfer complete
+    LL_DMA_DisableIT_HT(DMA1, LL_DMA_CHANNEL_3);
     LL_DMA_DisableIT_TC(DMA1, LL_DMA_CHANNEL_3);
 
     LL_DMA_DisableChannel(DMA1, LL_DMA_CHANNEL_3);
@@ -131,61 +563,579 @@ static int stm32ldac_stop(const struct device *dev)
     return 0;
 }
 
+#ifdef CONFIG_STM32LDAC_CYCLE_STATS
 /**
- * @brief Play audio data in the WAV format via DAC 
+ * Prints how many CPU cycles it has taken to fill one buffer half, compared to
+ * how many cycles it takes DMA to send it at the sample rate
+ */
+static void stm32ldac_print_cycle_stats(struct stm32ldac_data *data)
+{
+    if (data->fill_blocks == 0) {
+        return;
+    }
+
+    //the timer ticks at the CPU clock, one sample every timer_autoreload + 1 cycles
+    uint32_t budget = BUFFERSIZE * (data->timer_autoreload + 1);
+    uint32_t average = data->fill_cycles_total / data->fill_blocks;
+
+    LOG_INF("Fill cycles per %u samples, format 0x%04x: average %lu, max %lu, budget %lu, load %lu%%",
+        BUFFERSIZE, data->stream.format, (unsigned long)average, (unsigned long)data->fill_cycles_max, 
+        (unsigned long)budget, (unsigned long)((data->fill_cycles_max * 100ULL) / budget));
+}
+#endif
+
+/**
+ * Plays the sequence of 16-bit PCM or compressed WAV audio. The samples are decoded into 12-bit DAC values
+ * and sent through both halves of the DMA buffer in the circular mode.
  *
- * @param dev         Pointer to the device structure for the driver instance
- * @param audio_data  Audio data in the WAV format
- * @param play_times  How many times to play the audio
- * @param play_delay  The delay before the next play 
+ * @param dev               Pointer to the device structure for the driver instance
+ * @param sequence_samples  The number of samples of all plays and the silence between them
+ * @param dma_timeout       How long to wait for DMA to send a buffer
  *
- * @retval 0        On success.
- * @retval -EINVAL  If a parameter with an invalid value has been provided.
+ * @retval 0           On success.
+ * @retval -EIO        If DMA has stopped sending the audio data.
+ * @retval -EBADMSG    If the compressed audio data is corrupt.
+ * @retval -ECANCELED  If the play has been cancelled.
  */
+static int stm32ldac_play_buffered(const struct device *dev, uint64_t sequence_samples, 
+    k_timeout_t dma_timeout)
+{
+    struct stm32ldac_data *data = (struct stm32ldac_data *)dev->data;
 
-static int stm32ldac_play_audio(const struct device *dev, uint8_t const* audio_data, 
-    const uint16_t play_times, const uint16_t play_delay)
+    //how many buffer halves contain audio, the loops and the silence between plays included
+    uint32_t blocks = (sequence_samples + BUFFERSIZE - 1) / BUFFERSIZE;
+
+    //decode from the beginning of the audio data
+    data->corrupt = false;
+    stm32ldac_stream_restart(data);
+
+#ifdef CONFIG_STM32LDAC_CYCLE_STATS
+    data->fill_cycles_total = 0;
+    data->fill_cycles_max = 0;
+    data->fill_blocks = 0;
+#endif
+
+    //fill both buffers before starting DMA
+    stm32ldac_fill_bank(data, 0);
+    stm32ldac_fill_bank(data, 1);
+
+    if (data->corrupt) {
+        LOG_ERR("The audio data is corrupt");
+        return -EBADMSG;
+    }
+
+    k_sem_reset(&data->dma_sem);
+    LL_DMA_ClearFlag_HT3(DMA1);
+    LL_DMA_ClearFlag_TC3(DMA1);
+
+    //cancelled before DMA has started, the give has just been reset
+    if (data->cancel) {
+        return -ECANCELED;
+    }
+
+    // Set DMA transfer addresses of source and destination
+    // DMA goes through both buffers and then wraps around to the first one
+    LL_DMA_ConfigAddresses(DMA1,
+        LL_DMA_CHANNEL_3,
+        (uint32_t)dma_buffer,
+        LL_DAC_DMA_GetRegAddr(DAC1, LL_DAC_CHANNEL_1, LL_DAC_DMA_REG_DATA_12BITS_RIGHT_ALIGNED),
+        LL_DMA_DIRECTION_MEMORY_TO_PERIPH);
+
+    // Set DMA transfer size, DMA restarts from the beginning of the first buffer
+    LL_DMA_SetDataLength(DMA1, LL_DMA_CHANNEL_3, 2 * BUFFERSIZE);
+
+    // Activation of DMA
+    // The DMA channel keeps running until the whole sound has been sent
+    LL_DMA_EnableChannel(DMA1, LL_DMA_CHANNEL_3);
+
+    // Enable DAC channel DMA request
+    LL_DAC_EnableDMAReq(DAC1, LL_DAC_CHANNEL_1);
+
+    // Enable DAC channel
+    LL_DAC_Enable(DAC1, LL_DAC_CHANNEL_1);
+
+#ifdef CONFIG_STM32LDAC_CYCLE_STATS
+    data->start_cycles = k_cycle_get_32() - data->start_cycles;
+#endif
+
+    uint8_t bank = 0;
+    for (uint32_t played = 0; played < blocks; played++) {
+        // sleep until DMA has sent the buffer
+        if (k_sem_take(&data->dma_sem, dma_timeout) != 0) {
+            LOG_ERR("DMA has stalled, stopping the audio");
+
+            stm32ldac_stop_dma();
+
+            return -EIO;
+        }
+
+        if (data->cancel) {
+            LOG_INF("The audio has been cancelled");
+
+            stm32ldac_stop_dma();
+
+            return -ECANCELED;
+        }
+
+        //refill the sent buffer while DMA is sending the other one
+        stm32ldac_fill_bank(data, bank);
+
+        if (data->corrupt) {
+            LOG_ERR("The audio data is corrupt, stopping the audio");
+
+            stm32ldac_stop_dma();
+
+            return -EBADMSG;
+        }
+
+        bank = !bank;
+    }
+
+    //DMA is sending silence now, stop it
+    stm32ldac_stop_dma();
+
+#ifdef CONFIG_STM32LDAC_CYCLE_STATS
+    stm32ldac_print_cycle_stats(data);
+#endif
+
+    return 0;
+}
+
+/**
+ * Plays the sequence of DAC-native audio. DMA sends the samples straight from the flash to the DAC register
+ * without any conversion or copying, and the silence between plays from one value.
+ * The DMA interrupt chains the parts, the thread sleeps until the whole sequence has been sent.
+ *
+ * @param dev          Pointer to the device structure for the driver instance
+ * @param dma_timeout  How long to wait for DMA to send the whole sequence
+ *
+ * @retval 0           On success.
+ * @retval -EIO        If DMA has stopped sending the audio data.
+ * @retval -ECANCELED  If the play has been cancelled.
+ */
+static int stm32ldac_play_direct(const struct device *dev, k_timeout_t dma_timeout)
 {
-    ARG_UNUSED(dev);
+    struct stm32ldac_data *data = (struct stm32ldac_data *)dev->data;
 
-    printk("In DAC play audio\n");
+    k_sem_reset(&data->dma_sem);
+    LL_DMA_ClearFlag_HT3(DMA1);
+    LL_DMA_ClearFlag_TC3(DMA1);
 
-    stm32ldac_enable_enable_gpio(dev);
-    
-    //parse the audio data in the WAV format
-    WAVFile wav_data = WAV_ParseFileData(audio_data);
+    //cancelled before DMA has started, the give has just been reset
+    if (data->cancel) {
+        return -ECANCELED;
+    }
+
+    stm32ldac_direct_restart(data);
+
+    // Set DMA transfer address of the destination, the source is set for every segment
+    LL_DMA_SetPeriphAddress(DMA1, LL_DMA_CHANNEL_3,
+        LL_DAC_DMA_GetRegAddr(DAC1, LL_DAC_CHANNEL_1, data->dac_register));
+
+    //the first segment, the DMA interrupt chains the rest
+    stm32ldac_start_segment(data);
+
+    // Enable DAC channel DMA request
+    LL_DAC_EnableDMAReq(DAC1, LL_DAC_CHANNEL_1);
 
-    //we use 16-bit WAV files, so each sample consist of 2 bytes, low and high, in a WAV file
-    //the data_length is in bytes, find the number of 16-bit samples
-    uint32_t samples = wav_data.data_length / 2;
+    // Enable DAC channel
+    LL_DAC_Enable(DAC1, LL_DAC_CHANNEL_1);
 
-    printk("Data length: %lu\n", (unsigned long)samples);
+#ifdef CONFIG_STM32LDAC_CYCLE_STATS
+    data->start_cycles = k_cycle_get_32() - data->start_cycles;
+#endif
+
+    //sleep until the last segment has been sent
+    int ret = k_sem_take(&data->dma_sem, dma_timeout);
+
+    //the DMA interrupt must not chain another segment while DMA is being stopped
+    unsigned int key = irq_lock();
+
+    data->direct_left = 0;
+    data->direct_loops_left = 0;
+    data->direct_tail_left = 0;
+    data->gap_left = 0;
+    data->repeats_left = 0;
+    stm32ldac_stop_dma();
 
-    if ((strcmp(wav_data.header.file_id, "RIFF") != 0) || (strcmp(wav_data.header.format, "WAVE") != 0)) {
-        printk("Incorrect audio format. Only WAV is supported. File id: %s, format: %s\n", wav_data.header.file_id, wav_data.header.format);
+    irq_unlock(key);
+
+    if (data->cancel) {
+        LOG_INF("The audio has been cancelled");
+        return -ECANCELED;
+    }
+
+    if (ret != 0) {
+        LOG_ERR("DMA has stalled, stopping the audio");
+        return -EIO;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Play an audio asset via DAC 
+ *
+ * 16-bit PCM audio is converted, IMA ADPCM, lossless, mu-law and A-law audio is decoded 
+ * to 12-bit DAC values block by block.
+ * DAC-native audio (8-bit PCM, WAV_FORMAT_DAC12R, WAV_FORMAT_DAC12L) is sent by DMA
+ * straight from the flash.
+ * The loop of the asset is played loop_count times in a row without a gap.
+ *
+ * The plays are one sequence: TIM6 and DMA keep running through the silence between plays,
+ * so the timing is sample exact and the thread sleeps until the sequence ends or is cancelled.
+ *
+ * The caller owns the DAC, see stm32ldac_acquire.
+ *
+ * @param dev          Pointer to the device structure for the driver instance
+ * @param asset        The audio asset
+ * @param play_times   How many times to play the audio
+ * @param gap_samples  The silence between plays in samples
+ *
+ * @retval 0           On success.
+ * @retval -EINVAL     If a parameter with an invalid value has been provided.
+ * @retval -EIO        If DMA has stopped sending the audio data.
+ * @retval -EBADMSG    If the compressed audio data is corrupt.
+ * @retval -ECANCELED  If the play has been cancelled.
+ */
+static int stm32ldac_play_sequence(const struct device *dev, const struct stm32dac_asset *asset, 
+    const uint16_t play_times, const uint32_t gap_samples)
+{
+    struct stm32ldac_data *data = (struct stm32ldac_data *)dev->data;
+    int ret = 0;
+
+#ifdef CONFIG_STM32LDAC_CYCLE_STATS
+    //from the play request to the DAC taking the first sample
+    data->start_cycles = k_cycle_get_32();
+
+    data->irq_latency_total = 0;
+    data->irq_latency_max = 0;
+    data->irq_count = 0;
+#endif
+
+    if ((asset == NULL) || (asset->data == NULL) || (asset->sample_rate == 0)) {
+        LOG_ERR("Invalid audio asset");
         return -EINVAL;
     }
 
-    if ((wav_data.header.number_of_channels != 1) || (wav_data.header.bits_per_sample != 16)) {
-        printk("Only 16-bit mono audio is supported. Number of channels: %u, bits per sample: %u\n", 
-            wav_data.header.number_of_channels, wav_data.header.bits_per_sample);
+    if (play_times == 0) {
+        return 0;
+    }
+
+    //DAC-native formats are sent by DMA straight to the DAC data register
+    bool direct = true;
+    data->direct = false;
+    data->stream.format = asset->format;
+
+    //the length is in bytes, find the number of samples
+    uint32_t samples = 0;
+
+    if ((asset->format == WAV_FORMAT_PCM) && (asset->bits_per_sample == 16)) {
+        //signed 16-bit samples are converted to 12-bit DAC values
+        direct = false;
+        data->dac_register = LL_DAC_DMA_REG_DATA_12BITS_RIGHT_ALIGNED;
+        data->sample_size = 2;
+    } else if ((asset->format == WAV_FORMAT_IMA_ADPCM) && (asset->bits_per_sample == 4)) {
+        //4-bit codes are decoded to 12-bit DAC values
+        direct = false;
+        data->dac_register = LL_DAC_DMA_REG_DATA_12BITS_RIGHT_ALIGNED;
+        data->sample_size = 2;
+        samples = ADPCM_SampleCount(asset->length, asset->block_align);
+        if ((asset->sample_count > 0) && (asset->sample_count < samples)) {
+            //the last block is padded
+            samples = asset->sample_count;
+        }
+    } else if ((asset->format == WAV_FORMAT_LOSSLESS) && (asset->bits_per_sample == 16)) {
+        //the frames are decoded to 16-bit samples, then to 12-bit DAC values
+        direct = false;
+        data->dac_register = LL_DAC_DMA_REG_DATA_12BITS_RIGHT_ALIGNED;
+        data->sample_size = 2;
+        //the frames have a variable size, the number of samples comes with the asset
+        samples = asset->sample_count;
+    } else if (((asset->format == WAV_FORMAT_MULAW) || (asset->format == WAV_FORMAT_ALAW))
+        && (asset->bits_per_sample == 8)) {
+        //8-bit codes are expanded to 12-bit DAC values through the table
+        direct = false;
+        data->dac_register = LL_DAC_DMA_REG_DATA_12BITS_RIGHT_ALIGNED;
+        data->sample_size = 1;
+        G711_BuildTable(g711_table, asset->format);
+    } else if ((asset->format == WAV_FORMAT_PCM) && (asset->bits_per_sample == 8)) {
+        //unsigned 8-bit samples are what the 8-bit DAC register expects
+        data->dac_register = LL_DAC_DMA_REG_DATA_8BITS_RIGHT_ALIGNED;
+        data->sample_size = 1;
+    } else if ((asset->format == WAV_FORMAT_DAC12R) && (asset->bits_per_sample == 16)) {
+        data->dac_register = LL_DAC_DMA_REG_DATA_12BITS_RIGHT_ALIGNED;
+        data->sample_size = 2;
+    } else if ((asset->format == WAV_FORMAT_DAC12L) && (asset->bits_per_sample == 16)) {
+        //the DAC takes the upper 12 bits of the left aligned register
+        data->dac_register = LL_DAC_DMA_REG_DATA_12BITS_LEFT_ALIGNED;
+        data->sample_size = 2;
+    } else {
+        LOG_ERR("Unsupported audio format: %u, bits per sample: %u", 
+            asset->format, asset->bits_per_sample);
         return -EINVAL;
     }
+
+    if ((asset->format != WAV_FORMAT_IMA_ADPCM) && (asset->format != WAV_FORMAT_LOSSLESS)) {
+        samples = asset->length / data->sample_size;
+    }
+
+    LOG_DBG("Data length: %lu", (unsigned long)samples);
+
+    //nothing to play, the amplifier stays off
+    if (samples == 0) {
+        return 0;
+    }
+
+    //the sustain loop is played loop_count times in a row without a gap
+    data->loop_start = 0;
+    data->loop_end = 0;
+    data->loop_repeats = 0;
+
+    if (asset->loop_count > 1) {
+        if ((asset->loop_start < asset->loop_end) && (asset->loop_end <= samples)) {
+            data->loop_start = asset->loop_start;
+            data->loop_end = asset->loop_end;
+            data->loop_repeats = asset->loop_count - 1;
+        } else {
+            LOG_WRN("The loop %lu-%lu is outside the audio, playing without the loop", 
+                (unsigned long)asset->loop_start, (unsigned long)asset->loop_end);
+        }
+    }
     
-    printk("Clock: %lu\n", (unsigned long)sys_clock_hw_cycles_per_sec());
-    //calculate the timer autoreload value to play the wav data according to its sample rate.
-    //get the processor speed and divide it to the sample rate minus 1 (the timer starts from 0)
-    uint16_t timer_autoreload = (sys_clock_hw_cycles_per_sec() / wav_data.header.sample_rate) - 1;
+    //the asset may come with the timer autoreload value computed at compile time
+    uint16_t timer_autoreload = asset->timer_autoreload;
+
+    if (timer_autoreload == 0) {
+        LOG_DBG("Clock: %lu", (unsigned long)sys_clock_hw_cycles_per_sec());
+        //calculate the timer autoreload value to play the wav data according to its sample rate.
+        //get the processor speed and divide it to the sample rate minus 1 (the timer starts from 0)
+        timer_autoreload = (sys_clock_hw_cycles_per_sec() / asset->sample_rate) - 1;
+    }
 
-    printk("Timer autoreload: %lu\n", (unsigned long)timer_autoreload);
+    LOG_DBG("Timer autoreload: %lu", (unsigned long)timer_autoreload);
+    data->timer_autoreload = timer_autoreload;
+    data->sample_rate = asset->sample_rate;
+
+    //the sequence: every play with its loop and the silence between plays
+    data->audio = asset->data;
+    data->length = asset->length;
+    data->samples = samples;
+    data->block_align = asset->block_align;
+    data->repeats_left = play_times - 1;
+    data->gap_samples = gap_samples;
+
+    uint32_t play_samples = samples + data->loop_repeats * (data->loop_end - data->loop_start);
+    uint64_t sequence_samples = (uint64_t)play_times * play_samples + (uint64_t)(play_times - 1) * gap_samples;
+
+    //the silence value for the DAC data register DMA writes to
+    if (data->dac_register == LL_DAC_DMA_REG_DATA_8BITS_RIGHT_ALIGNED) {
+        data->direct_silence = DAC_SILENCE >> 4;
+    } else if (data->dac_register == LL_DAC_DMA_REG_DATA_12BITS_LEFT_ALIGNED) {
+        data->direct_silence = DAC_SILENCE << 4;
+    } else {
+        data->direct_silence = DAC_SILENCE;
+    }
+
+    //how long to wait for DMA before giving up
+    //it's twice the time of playing one buffer (or the whole direct sequence), 
+    //plus some margin for slow sample rates
+    uint64_t wait_samples = direct ? sequence_samples : 2 * BUFFERSIZE;
+    k_timeout_t dma_timeout = K_MSEC((wait_samples * 1000) / asset->sample_rate + DMA_TIMEOUT_MARGIN_MS);
+
+
+    //the peripherals have been set up by stm32ldac_setup, only what depends on the asset is written here
+    uint32_t dma_config = LL_DMA_DIRECTION_MEMORY_TO_PERIPH | LL_DMA_PERIPH_NOINCREMENT 
+        | LL_DMA_MEMORY_INCREMENT | LL_DMA_PRIORITY_LOW;
 
+    data->direct = direct;
+
+    if (direct) {
+        //DMA goes through the audio in the flash once, segment by segment
+        dma_config |= LL_DMA_MODE_NORMAL;
+    } else {
+        //DMA goes around the two buffers until the whole sound has been sent
+        dma_config |= LL_DMA_MODE_CIRCULAR;
+    }
+
+    //the buffered formats are always decoded into 16-bit DAC values
+    if (direct && (data->sample_size == 1)) {
+        dma_config |= LL_DMA_PDATAALIGN_BYTE | LL_DMA_MDATAALIGN_BYTE;
+    } else {
+        dma_config |= LL_DMA_PDATAALIGN_HALFWORD | LL_DMA_MDATAALIGN_HALFWORD;
+    }
+
+    //one write of the channel configuration register, the channel is disabled
+    LL_DMA_ConfigTransfer(DMA1, LL_DMA_CHANNEL_3, dma_config);
+
+    if (direct) {
+        LL_DMA_DisableIT_HT(DMA1, LL_DMA_CHANNEL_3);
+    } else {
+        LL_DMA_EnableIT_HT(DMA1, LL_DMA_CHANNEL_3);
+    }
+
+    //enable the transfer complete interrupt
+    LL_DMA_EnableIT_TC(DMA1, LL_DMA_CHANNEL_3);
+
+    //the timer keeps its autoreload value until the sample rate changes
+    if (timer_autoreload != data->armed_autoreload) {
+        LL_TIM_SetAutoReload(TIM6, timer_autoreload);
+        data->armed_autoreload = timer_autoreload;
+    }
+
+    //the asset is valid, switch the amplifier on
+    stm32ldac_enable_enable_gpio(dev);
+
+    //Enable the timer 6. The DAC sends the next sample on the next tick.
+    //the counter may be above the new autoreload value after the last play
+    LL_TIM_SetCounter(TIM6, 0);
+    LL_TIM_EnableCounter(TIM6);
+
+
+    //play the audio several times
+    if (direct) {
+        ret = stm32ldac_play_direct(dev, dma_timeout);
+    } else {
+        ret = stm32ldac_play_buffered(dev, sequence_samples, dma_timeout);
+    }
+
+#ifdef CONFIG_STM32LDAC_CYCLE_STATS
+    LOG_INF("Start latency: %lu cycles, %lu us", (unsigned long)data->start_cycles,
+        (unsigned long)k_cyc_to_us_floor32(data->start_cycles));
+
+    if (data->irq_count > 0) {
+        LOG_INF("DMA interrupt entry latency in cycles: average %lu, max %lu",
+            (unsigned long)(data->irq_latency_total / data->irq_count), 
+            (unsigned long)data->irq_latency_max);
+    }
+#endif
+
+    if ((ret == -ECANCELED) || (ret == -EBADMSG)) {
+        //ramp down to silence and switch the amplifier off
+        stm32ldac_fade_out(dev);
+    }
+
+    //stm32ldac_stop(dev);
+
+    return ret;
+}
+
+/**
+ * Parses the chunks of the WAV file into an asset
+ *
+ * @param audio_data  Audio data in the WAV format
+ * @param asset       The asset to fill
+ *
+ * @retval 0        On success.
+ * @retval -EINVAL  If the audio isn't a mono WAV file.
+ */
+static int stm32ldac_wav_asset(uint8_t const* audio_data, struct stm32dac_asset *asset)
+{
+    //the file can't go past the end of the memory it's in, the parser checks the chunk sizes against it
+    uintptr_t start = (uintptr_t)audio_data;
+    uint32_t max_size = 0;
+
+    if ((start >= CONFIG_FLASH_BASE_ADDRESS) && (start < WAV_FLASH_END)) {
+        max_size = WAV_FLASH_END - start;
+    } else if ((start >= CONFIG_SRAM_BASE_ADDRESS) && (start < WAV_SRAM_END)) {
+        max_size = WAV_SRAM_END - start;
+    } else {
+        LOG_ERR("The audio data isn't in the flash or the RAM");
+        return -EINVAL;
+    }
+
+    //parse the audio data in the WAV format
+    WAVFile wav_data;
+    WAVResult result = WAV_ParseFile(audio_data, max_size, &wav_data);
+
+    if (result != WAV_OK) {
+        LOG_ERR("Incorrect audio format. Only WAV is supported. Error: %d", result);
+        return -EINVAL;
+    }
+
+    if (wav_data.number_of_channels != 1) {
+        LOG_ERR("Only mono audio is supported. Number of channels: %u", wav_data.number_of_channels);
+        return -EINVAL;
+    }
+
+    *asset = (struct stm32dac_asset) {
+        .data = wav_data.data,
+        .length = wav_data.data_length,
+        .sample_count = wav_data.sample_count,
+        .sample_rate = wav_data.sample_rate,
+        .loop_start = wav_data.loop_start,
+        .loop_end = wav_data.loop_end,
+        //0 is an endless loop in the smpl chunk, it's played once
+        .loop_count = (wav_data.loop_play_count <= UINT16_MAX) ? wav_data.loop_play_count : UINT16_MAX,
+        .format = wav_data.audio_format,
+        .bits_per_sample = wav_data.bits_per_sample,
+        .block_align = wav_data.block_align,
+    };
+
+    return 0;
+}
+
+#ifdef CONFIG_STM32LDAC_CONVERT_SELFTEST
+/**
+ * Checks that the fast sample conversion gives the same DAC values as the reference one
+ * for every possible 16-bit sample
+ */
+static void stm32ldac_convert_selftest(void)
+{
+    static uint8_t src[2 * BUFFERSIZE];
+    uint32_t errors = 0;
+
+    for (uint32_t first = 0; first < 0x10000; first += BUFFERSIZE) {
+        for (uint32_t i = 0; i < BUFFERSIZE; i++) {
+            src[2 * i] = (first + i) & 0xFF;
+            src[2 * i + 1] = (first + i) >> 8;
+        }
+
+        //dma_buffer is free before the first play
+        stm32ldac_convert_ref(dma_buffer[0], src, BUFFERSIZE);
+        stm32ldac_convert(dma_buffer[1], src, BUFFERSIZE);
+
+        if (memcmp(dma_buffer[0], dma_buffer[1], sizeof(dma_buffer[0])) != 0) {
+            errors++;
+        }
+    }
+
+    LOG_INF("Sample conversion self test: %s", (errors == 0) ? "passed" : "FAILED");
+}
+#endif
+
+/**
+ * Sets up the amplifier pin, the clocks, DMA and the DAC on the first play,
+ * so a wake that doesn't play anything doesn't wait for it.
+ * The caller owns the DAC, see stm32ldac_acquire.
+ */
+static void stm32ldac_setup(const struct device *dev)
+{
+    struct stm32ldac_data *data = (struct stm32ldac_data *)dev->data;
+    const struct stm32ldac_config *config = (const struct stm32ldac_config *)dev->config;
+
+    if (data->ready) {
+        return;
+    }
+
+    LOG_INF("Configuring STM32L4 DAC Wave signal");
+
+#ifdef CONFIG_STM32LDAC_CONVERT_SELFTEST
+    stm32ldac_convert_selftest();
+#endif
+
+    stm32ldac_init_enable_gpio(dev);
 
     // DMA controller clock enable
     LL_AHB1_GRP1_EnableClock(LL_AHB1_GRP1_PERIPH_DMA1);
 
     // DMA interrupt init
     // DMA1_Channel3_IRQn interrupt configuration
-    IRQ_CONNECT(IRQ_DMA_CHANNEL, 6, stm32ldac_irq_handler, 0, 0);
+#ifdef CONFIG_STM32LDAC_DIRECT_ISR
+    IRQ_DIRECT_CONNECT(IRQ_DMA_CHANNEL, IRQ_DMA_PRIORITY, stm32ldac_dma_isr, 0);
+#else
+    IRQ_CONNECT(IRQ_DMA_CHANNEL, IRQ_DMA_PRIORITY, stm32ldac_irq_handler, DEVICE_DT_INST_GET(0), 0);
+#endif
     irq_enable(IRQ_DMA_CHANNEL); 
 
     //Enable DAC
@@ -195,6 +1145,7 @@ static int stm32ldac_play_audio(const struct device *dev, uint8_t const* audio_d
     // Peripheral clock enable
     LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_DAC1);
     LL_AHB2_GRP1_EnableClock(LL_AHB2_GRP1_PERIPH_GPIOA);
+    LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_TIM6);
 
     // DAC1 GPIO Configuration PA4   ------> DAC1_OUT1
     GPIO_InitStruct.Pin = LL_GPIO_PIN_4;
@@ -206,11 +1157,7 @@ static int stm32ldac_play_audio(const struct device *dev, uint8_t const* audio_d
     LL_DMA_SetPeriphRequest(DMA1, LL_DMA_CHANNEL_3, LL_DMA_REQUEST_6);
     LL_DMA_SetDataTransferDirection(DMA1, LL_DMA_CHANNEL_3, LL_DMA_DIRECTION_MEMORY_TO_PERIPH);
     LL_DMA_SetChannelPriorityLevel(DMA1, LL_DMA_CHANNEL_3, LL_DMA_PRIORITY_LOW);
-    LL_DMA_SetMode(DMA1, LL_DMA_CHANNEL_3, LL_DMA_MODE_NORMAL);
     LL_DMA_SetPeriphIncMode(DMA1, LL_DMA_CHANNEL_3, LL_DMA_PERIPH_NOINCREMENT);
-    LL_DMA_SetMemoryIncMode(DMA1, LL_DMA_CHANNEL_3, LL_DMA_MEMORY_INCREMENT);
-    LL_DMA_SetPeriphSize(DMA1, LL_DMA_CHANNEL_3, LL_DMA_PDATAALIGN_HALFWORD);
-    LL_DMA_SetMemorySize(DMA1, LL_DMA_CHANNEL_3, LL_DMA_MDATAALIGN_HALFWORD);
 
     // DAC channel OUT1 config
     DAC_InitStruct.TriggerSource = LL_DAC_TRIG_EXT_TIM6_TRGO;
@@ -221,99 +1168,248 @@ static int stm32ldac_play_audio(const struct device *dev, uint8_t const* audio_d
     LL_DAC_Init(DAC1, LL_DAC_CHANNEL_1, &DAC_InitStruct);
     LL_DAC_EnableTrigger(DAC1, LL_DAC_CHANNEL_1);
 
-    //enable the transfer complete interrupt
-    LL_DMA_EnableIT_TC(DMA1, LL_DMA_CHANNEL_3);
-
-    //Enable the timer 6. The DAC sends the next sample on the next tick.
+    //the timer 6 triggers the DAC, every play sets its autoreload value for the sample rate
     LL_TIM_InitTypeDef TIM_InitStruct = {0};
 
-    // Peripheral clock enable
-    LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_TIM6);
-
     TIM_InitStruct.Prescaler = 0;
     TIM_InitStruct.CounterMode = LL_TIM_COUNTERMODE_UP;
-    TIM_InitStruct.Autoreload = timer_autoreload;
+    TIM_InitStruct.Autoreload = 0;
     LL_TIM_Init(TIM6, &TIM_InitStruct);
     LL_TIM_DisableARRPreload(TIM6);
     LL_TIM_SetTriggerOutput(TIM6, LL_TIM_TRGO_UPDATE);
     LL_TIM_DisableMasterSlaveMode(TIM6);
-    LL_TIM_EnableCounter(TIM6);
-    
+    data->armed_autoreload = 0;
 
-    //play the audio several times
-    for (uint16_t k = 0; k < play_times; k++) {
-        //where audio data starts
-        const uint8_t* p = wav_data.data;
-
-        uint8_t bank = 0;
-        dma_complete = 1;
-
-        uint32_t count = samples;
-        while (0 < count) {
-            //the last audio chunk can be smaller than the buffer size
-            uint32_t block_size = (count <= BUFFERSIZE) ? count : BUFFERSIZE;
-
-            for (int i = 0; i < block_size; i++) {
-                //the low order byte of a 16-bit wav file
-                uint8_t low_byte = *p;
-                p++;
-                //the high order byte of a 16-bit wav file
-                uint8_t high_byte = *p;
-                p++;
-
-                //combine the low and high bytes to create a 16-bit DAC value
-                //values in a wav file are stored signed in the range -32767 to 32768
-                //convert the DAC value to unsigned in the range 0-65535 by adding 32767
-                uint16_t dac_value = ((high_byte << 8) | low_byte) + 32767;
-
-                //the STM32 DAC is 12 bit, it can represent the values in the range 0-4095
-                // 65535/4095 = 16
-                dac_value /= 16;
-
-                dma_buffer[bank][i] = dac_value;
-            }
+    //the thread plays the asynchronous requests
+    k_tid_t tid = k_thread_create(&data->thread, config->stack, config->stack_size,
+        stm32ldac_thread, (void *)dev, NULL, NULL,
+        CONFIG_STM32LDAC_THREAD_PRIORITY, 0, K_NO_WAIT);
+    k_thread_name_set(tid, "stm32ldac");
 
-            // wait for DMA complete
-            while(!dma_complete) {
-                //__NOP();
-                k_busy_wait(10);
-            }
+    data->ready = true;
+}
 
-            dma_complete = 0;
+/**
+ * Takes the DAC for one play, only one play can run at a time
+ *
+ * @retval 0       On success.
+ * @retval -EBUSY  If another play hasn't ended yet.
+ */
+static int stm32ldac_acquire(const struct device *dev)
+{
+    struct stm32ldac_data *data = (struct stm32ldac_data *)dev->data;
 
-            //Disable the DMA channel to configure it
-            LL_DMA_DisableChannel(DMA1, LL_DMA_CHANNEL_3);
+    if (!atomic_cas(&data->busy, 0, 1)) {
+        LOG_WRN("The DAC is busy with another play");
+        return -EBUSY;
+    }
 
-            // Set DMA transfer addresses of source and destination
-            LL_DMA_ConfigAddresses(DMA1,
-                LL_DMA_CHANNEL_3,
-                (uint32_t)dma_buffer[bank],
-                LL_DAC_DMA_GetRegAddr(DAC1, LL_DAC_CHANNEL_1, LL_DAC_DMA_REG_DATA_12BITS_RIGHT_ALIGNED),
-                LL_DMA_DIRECTION_MEMORY_TO_PERIPH);
+    data->cancel = false;
 
-            // Set DMA transfer size
-            LL_DMA_SetDataLength(DMA1,
-                LL_DMA_CHANNEL_3,
-                block_size);
+    stm32ldac_setup(dev);
 
-            // Activation of DMA
-            // Enable the DMA transfer
-            LL_DMA_EnableChannel(DMA1, LL_DMA_CHANNEL_3);
+    return 0;
+}
 
-            // Enable DAC channel DMA request
-            LL_DAC_EnableDMAReq(DAC1, LL_DAC_CHANNEL_1);
+/**
+ * @brief Play an audio asset several times via DAC, see stm32ldac_play_sequence
+ */
+static int stm32ldac_play_repeated(const struct device *dev, const struct stm32dac_asset *asset, 
+    const uint16_t play_times, const uint32_t gap_samples)
+{
+    struct stm32ldac_data *data = (struct stm32ldac_data *)dev->data;
 
-            // Enable DAC channel
-            LL_DAC_Enable(DAC1, LL_DAC_CHANNEL_1);
+    int ret = stm32ldac_acquire(dev);
 
-            bank = !bank;
-            count -= block_size;
-        }
+    if (ret != 0) {
+        return ret;
+    }
 
-        k_msleep(play_delay);
+    ret = stm32ldac_play_sequence(dev, asset, play_times, gap_samples);
+
+    atomic_clear(&data->busy);
+
+    return ret;
+}
+
+/**
+ * @brief Play audio data in the WAV format via DAC 
+ *
+ * The chunks of the WAV file are parsed into an asset, see stm32ldac_play_sequence.
+ *
+ * @param dev         Pointer to the device structure for the driver instance
+ * @param audio_data  Audio data in the WAV format
+ * @param play_times  How many times to play the audio
+ * @param play_delay  The delay before the next play in milliseconds
+ *
+ * @retval 0           On success.
+ * @retval -EINVAL     If a parameter with an invalid value has been provided.
+ * @retval -EIO        If DMA has stopped sending the audio data.
+ * @retval -EBADMSG    If the compressed audio data is corrupt.
+ * @retval -ECANCELED  If the play has been cancelled.
+ * @retval -EBUSY      If another play hasn't ended yet.
+ */
+static int stm32ldac_play_audio(const struct device *dev, uint8_t const* audio_data, 
+    const uint16_t play_times, const uint16_t play_delay)
+{
+    LOG_DBG("In DAC play audio");
+
+    struct stm32dac_asset asset;
+    int ret = stm32ldac_wav_asset(audio_data, &asset);
+
+    if (ret != 0) {
+        return ret;
     }
 
-    //stm32ldac_stop(dev);
+    //the delay is in milliseconds
+    return stm32ldac_play_repeated(dev, &asset, play_times, ((uint64_t)play_delay * asset.sample_rate) / 1000);
+}
+
+/**
+ * @brief Start playing an audio asset several times, the driver thread plays it
+ *
+ * @param dev          Pointer to the device structure for the driver instance
+ * @param asset        The audio asset, the descriptor is copied
+ * @param play_times   How many times to play the audio
+ * @param gap_samples  The silence between plays in samples
+ * @param callback     Called from the driver thread when the play has ended
+ * @param user_data    Passed to the callback
+ *
+ * @retval 0        On success.
+ * @retval -EINVAL  If a parameter with an invalid value has been provided.
+ * @retval -EBUSY   If another play hasn't ended yet.
+ */
+static int stm32ldac_play_repeated_async(const struct device *dev, const struct stm32dac_asset *asset, 
+    const uint16_t play_times, const uint32_t gap_samples,
+    stm32dac_play_callback_t callback, void *user_data)
+{
+    struct stm32ldac_data *data = (struct stm32ldac_data *)dev->data;
+
+    if ((asset == NULL) || (asset->data == NULL) || (asset->sample_rate == 0)) {
+        LOG_ERR("Invalid audio asset");
+        return -EINVAL;
+    }
+
+    int ret = stm32ldac_acquire(dev);
+
+    if (ret != 0) {
+        return ret;
+    }
+
+    //the thread takes the request, the DAC stays busy until the callback
+    data->request_asset = *asset;
+    data->request_play_times = play_times;
+    data->request_gap_samples = gap_samples;
+    data->callback = callback;
+    data->user_data = user_data;
+
+    k_sem_give(&data->request_sem);
+
+    return 0;
+}
+
+/**
+ * @brief Start playing audio data in the WAV format, the driver thread plays it
+ *
+ * @retval 0        On success.
+ * @retval -EINVAL  If a parameter with an invalid value has been provided.
+ * @retval -EBUSY   If another play hasn't ended yet.
+ */
+static int stm32ldac_play_audio_async(const struct device *dev, uint8_t const* audio_data, 
+    const uint16_t play_times, const uint16_t play_delay,
+    stm32dac_play_callback_t callback, void *user_data)
+{
+    struct stm32dac_asset asset;
+    int ret = stm32ldac_wav_asset(audio_data, &asset);
+
+    if (ret != 0) {
+        return ret;
+    }
+
+    return stm32ldac_play_repeated_async(dev, &asset, play_times, 
+        ((uint64_t)play_delay * asset.sample_rate) / 1000, callback, user_data);
+}
+
+/**
+ * @brief Sets up the peripherals ahead of the first play, so it starts with a few register writes
+ *
+ * @retval 0       On success, also if the setup has been done already.
+ * @retval -EBUSY  If a play is in progress before the setup has run.
+ */
+static int stm32ldac_prepare(const struct device *dev)
+{
+    struct stm32ldac_data *data = (struct stm32ldac_data *)dev->data;
+
+    if (data->ready) {
+        return 0;
+    }
+
+    int ret = stm32ldac_acquire(dev);
+
+    if (ret != 0) {
+        return ret;
+    }
+
+    atomic_clear(&data->busy);
+
+    return 0;
+}
+
+/**
+ * @brief Gets the playback status
+ */
+static enum stm32dac_status stm32ldac_playback_status(const struct device *dev)
+{
+    struct stm32ldac_data *data = (struct stm32ldac_data *)dev->data;
+
+    return atomic_get(&data->busy) ? STM32DAC_STATUS_PLAYING : STM32DAC_STATUS_IDLE;
+}
+
+/**
+ * The driver thread, it plays the asynchronous requests one by one.
+ * The DMA buffer is refilled here, so the thread that has started the play is free.
+ */
+static void stm32ldac_thread(void *p1, void *p2, void *p3)
+{
+    const struct device *dev = (const struct device *)p1;
+    struct stm32ldac_data *data = (struct stm32ldac_data *)dev->data;
+
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    while (1) {
+        k_sem_take(&data->request_sem, K_FOREVER);
+
+        int ret = stm32ldac_play_sequence(dev, &data->request_asset,
+            data->request_play_times, data->request_gap_samples);
+
+        stm32dac_play_callback_t callback = data->callback;
+        void *user_data = data->user_data;
+
+        //a new play can be started from the callback
+        atomic_clear(&data->busy);
+
+        if (callback != NULL) {
+            callback(dev, ret, user_data);
+        }
+    }
+}
+
+/**
+ * @brief Cancels the play, it can be called from an interrupt.
+ * The playing thread fades the output out and disables the amplifier.
+ *
+ * @param dev Pointer to the device structure for the driver instance
+ *
+ * @retval 0 On success.
+ */
+static int stm32ldac_cancel(const struct device *dev)
+{
+    struct stm32ldac_data *data = (struct stm32ldac_data *)dev->data;
+
+    //the playing thread checks the flag when it wakes up
+    data->cancel = true;
+    k_sem_give(&data->dma_sem);
 
     return 0;
 }
@@ -341,6 +1437,7 @@ static int stm32ldac_pm_action(const struct device *dev,
 #endif /* CONFIG_PM_DEVICE */
 
 
+
 /**
  * @brief Inits the driver
  *
@@ -350,9 +1447,14 @@ static int stm32ldac_pm_action(const struct device *dev,
  */
 static int stm32ldac_init(const struct device *dev)
 {
-    printk("Configuring STM32L4 DAC Wave signal\n");
+    struct stm32ldac_data *data = (struct stm32ldac_data *)dev->data;
 
-    stm32ldac_init_enable_gpio(dev);
+    //only the kernel objects, the hardware is set up on the first play
+    //given by the DMA interrupt every time a buffer has been sent
+    k_sem_init(&data->dma_sem, 0, 2);
+
+    //given for every asynchronous play
+    k_sem_init(&data->request_sem, 0, 1);
 
 #ifdef CONFIG_PM_DEVICE
     data->pm_state = PM_DEVICE_STATE_ACTIVE;
@@ -363,15 +1465,26 @@ static int stm32ldac_init(const struct device *dev)
 
 static const struct stm32dac_driver_api stm32ldac_api = {
     .play_audio = stm32ldac_play_audio,
+    .play_repeated = stm32ldac_play_repeated,
+    .play_audio_async = stm32ldac_play_audio_async,
+    .play_repeated_async = stm32ldac_play_repeated_async,
+    .playback_status = stm32ldac_playback_status,
+    .cancel = stm32ldac_cancel,
     .stop = stm32ldac_stop,
+    .prepare = stm32ldac_prepare,
 };
 
 #define STM32LDAC_INIT(inst)                                       \
 static struct stm32ldac_data stm32ldac_data_ ## inst = {};         \
                                                                    \
+K_KERNEL_STACK_DEFINE(stm32ldac_stack_ ## inst,                    \
+    CONFIG_STM32LDAC_THREAD_STACK_SIZE);                           \
+                                                                   \
 static struct stm32ldac_config stm32ldac_config_ ## inst = {       \
     .enable_gpio = GPIO_DT_SPEC_GET(DT_INST(inst, st_stm32dac),    \
-    enable_gpios)                                                  \
+    enable_gpios),                                                 \
+    .stack = stm32ldac_stack_ ## inst,                             \
+    .stack_size = K_KERNEL_STACK_SIZEOF(stm32ldac_stack_ ## inst), \
 };                                                                 \
                                                                    \
 PM_DEVICE_DT_INST_DEFINE(inst, stm32ldac_pm_action);               \
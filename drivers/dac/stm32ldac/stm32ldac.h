@@ -25,31 +25,149 @@
 #include <zephyr/devicetree.h>
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/pm/device.h>
-#include <zephyr/sys/printk.h>
 #include <soc.h>
 
-#include <zephyr/logging/log.h>
-LOG_MODULE_REGISTER(stm32ldac, CONFIG_KERNEL_LOG_LEVEL);
-
 #include <driver_stm32dac.h>
 #include "wave.h"
+#include "convert.h"
+#include "adpcm.h"
+#include "lossless.h"
+#include "g711.h"
 
 #define STM32DAC_NODE DT_INST(0, st_stm32dac)
 
 //the buffer to store audio data before sending it to DAC
 #define BUFFERSIZE 512
 
-//the IRQ number for DMA1 Channel3
-#define IRQ_DMA_CHANNEL 13
+//the 12-bit DAC value of a zero sample, the middle of the range 0-4095
+#define DAC_SILENCE 2048
+
+//the maximum number of items DMA can send without reprogramming
+#define DMA_MAX_ITEMS 65535
+
+//the extra time to wait for DMA to send a buffer
+#define DMA_TIMEOUT_MARGIN_MS 10
+
+//the ends of the memories a WAV file can be in, a file can't go past them
+#define WAV_FLASH_END (CONFIG_FLASH_BASE_ADDRESS + CONFIG_FLASH_SIZE * 1024)
+#define WAV_SRAM_END (CONFIG_SRAM_BASE_ADDRESS + CONFIG_SRAM_SIZE * 1024)
+
+//the IRQ number and priority of DMA1 Channel3 from the devicetree
+#define IRQ_DMA_CHANNEL DT_INST_IRQN(0)
+#define IRQ_DMA_PRIORITY DT_INST_IRQ(0, priority)
 
 /** @brief Driver config data */
 struct stm32ldac_config {
     struct gpio_dt_spec enable_gpio;
+    //the stack of the driver thread that plays the asynchronous requests
+    k_thread_stack_t *stack;
+    size_t stack_size;
+};
+
+/** @brief The audio that is decoded block by block into the DMA buffer */
+struct stm32ldac_stream {
+    //the audio format, one of WAV_FORMAT_*
+    uint16_t format;
+    //the next byte of 16-bit PCM audio data
+    const uint8_t *next;
+    //how many samples are left to decode
+    uint32_t left;
+    //the next sample to decode, from the beginning of the audio
+    uint32_t position;
+    //the IMA ADPCM decoder
+    ADPCMState adpcm;
+    //the lossless decoder
+    LosslessState lossless;
 };
 
 /** @brief Driver instance data */
 struct stm32ldac_data {
-    
+    //given by the DMA interrupt when a half of the DMA buffer has been sent
+    struct k_sem dma_sem;
+
+    //the audio that is decoded into the DMA buffer
+    struct stm32ldac_stream stream;
+
+    //the audio that is played, it's decoded or sent from the beginning for every play
+    const uint8_t *audio;
+    uint32_t length;
+    uint32_t samples;
+    uint16_t block_align;
+    //set when the decoder has found corrupt audio data, the play is stopped
+    bool corrupt;
+
+    //how many more plays are left after the current one
+    uint32_t repeats_left;
+    //the silence between plays in samples
+    uint32_t gap_samples;
+    //how many samples of silence are left before the next play
+    uint32_t gap_left;
+    //set by stm32ldac_cancel to stop the sequence
+    volatile bool cancel;
+    //1 from the start of a play until it has ended
+    atomic_t busy;
+    //the hardware and the thread have been set up by the first play
+    bool ready;
+
+    //the driver thread and the asynchronous play it's given
+    struct k_thread thread;
+    struct k_sem request_sem;
+    struct stm32dac_asset request_asset;
+    uint16_t request_play_times;
+    uint32_t request_gap_samples;
+    stm32dac_play_callback_t callback;
+    void *user_data;
+
+    //the sustain loop: the first sample, the sample after the last one
+    //and how many more times it's played after the first time
+    uint32_t loop_start;
+    uint32_t loop_end;
+    uint32_t loop_repeats;
+    //how many more times the loop is played during this play
+    uint32_t loops_left;
+    //the stream at the start of the loop, it's restored at the end of the loop
+    struct stm32ldac_stream loop_stream;
+
+    //TIM6 counts to this value at the CPU clock between samples
+    uint16_t timer_autoreload;
+    //the autoreload value TIM6 has now, it's written again only for another sample rate
+    uint16_t armed_autoreload;
+    //the sample rate of the play
+    uint32_t sample_rate;
+
+    //the DAC data register DMA writes to, one of LL_DAC_DMA_REG_DATA_*
+    uint32_t dac_register;
+    //the size of one sample in the audio data in bytes
+    uint8_t sample_size;
+
+    //if DMA sends DAC-native audio straight from the flash
+    volatile bool direct;
+    //the next DAC-native segment in the flash that DMA sends directly
+    const uint8_t *direct_next;
+    //how many DAC-native samples are left to send directly
+    volatile uint32_t direct_left;
+    //the loop and the rest of the audio after it, sent directly
+    const uint8_t *direct_loop;
+    volatile uint32_t direct_loops_left;
+    volatile uint32_t direct_tail_left;
+    //if DMA sends direct_silence between plays instead of the audio
+    bool direct_silent;
+    //the silence value in the format of the DAC data register
+    uint16_t direct_silence;
+
+#ifdef CONFIG_STM32LDAC_CYCLE_STATS
+    //the CPU cycles it has taken to fill the buffer halves during the last play
+    uint64_t fill_cycles_total;
+    uint32_t fill_cycles_max;
+    uint32_t fill_blocks;
+    //the CPU cycles from the play request to enabling the DAC
+    uint32_t start_cycles;
+    //the CPU cycles from the DMA request to the DMA interrupt handler during the last play
+    uint64_t irq_latency_total;
+    uint32_t irq_latency_max;
+    uint32_t irq_count;
+#endif
+
 #ifdef CONFIG_PM_DEVICE
     uint32_t pm_state;
 #endif
@@ -1,74 +1,147 @@
 #include "wave.h"
-#include <stdio.h>
 #include <string.h>
 
-// Convert 32-bit unsigned little-endian value to big-endian from byte array
+// the chunk header: 4 letters and the size of the chunk body
+#define WAV_CHUNK_HEADER_SIZE 8
+
+// the smpl chunk body: 9 words and then the loops of 6 words each
+#define WAV_SMPL_SIZE 36
+#define WAV_SMPL_LOOP_SIZE 24
+
+// Read 32-bit unsigned little-endian value from byte array
 static inline uint32_t little2big_u32(uint8_t const* data) {
-  return data[0] | (data[1] << 8) | (data[2] << 16) | (data[3] << 24);
+  return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
 }
 
-// Convert 16-bit unsigned little-endian value to big-endian from byte array
+// Read 16-bit unsigned little-endian value from byte array
 static inline uint16_t little2big_u16(uint8_t const* data) {
   return data[0] | (data[1] << 8);
 }
 
-// Copy n bytes from source to destination and terminate the destination with
-// null character. Destination must be at least (amount + 1) bytes big to
-// account for null character.
-static inline void bytes_to_string(uint8_t const* source,
-                                   char* destination,
-                                   size_t amount) {
-  memcpy(destination, source, amount);
-  destination[amount] = '\0';
+// Check the 4 letters of the chunk id without copying them
+static inline int is_chunk(uint8_t const* data, char const* id) {
+  return memcmp(data, id, 4) == 0;
 }
 
-// Parse the header of WAV file and return WAVFile structure with header and
-// pointer to data
-WAVFile WAV_ParseFileData(uint8_t const* data) {
-  WAVFile file;
-  uint8_t const* data_ptr = data;
-
-  bytes_to_string(data_ptr, file.header.file_id, 4);
-  data_ptr += 4;
-
-  file.header.file_size = little2big_u32(data_ptr);
-  data_ptr += 4;
-
-  bytes_to_string(data_ptr, file.header.format, 4);
-  data_ptr += 4;
-
-  bytes_to_string(data_ptr, file.header.subchunk_id, 4);
-  data_ptr += 4;
-
-  file.header.subchunk_size = little2big_u32(data_ptr);
-  data_ptr += 4;
-
-  file.header.audio_format = little2big_u16(data_ptr);
-  data_ptr += 2;
-
-  file.header.number_of_channels = little2big_u16(data_ptr);
-  data_ptr += 2;
-
-  file.header.sample_rate = little2big_u32(data_ptr);
-  data_ptr += 4;
-
-  file.header.byte_rate = little2big_u32(data_ptr);
-  data_ptr += 4;
-
-  file.header.block_align = little2big_u16(data_ptr);
-  data_ptr += 2;
-
-  file.header.bits_per_sample = little2big_u16(data_ptr);
-  data_ptr += 2;
-
-  bytes_to_string(data_ptr, file.header.data_id, 4);
-  data_ptr += 4;
-
-  file.header.data_size = little2big_u32(data_ptr);
-  data_ptr += 4;
+// Read the fmt chunk body
+static WAVResult parse_fmt(uint8_t const* body, uint32_t size, WAVFile* file) {
+  if (size < 16) {
+    return WAV_ERROR_NO_FMT;
+  }
+
+  file->fmt = body;
+  file->fmt_size = size;
+  file->audio_format = little2big_u16(body);
+  file->number_of_channels = little2big_u16(body + 2);
+  file->sample_rate = little2big_u32(body + 4);
+  file->byte_rate = little2big_u32(body + 8);
+  file->block_align = little2big_u16(body + 12);
+  file->bits_per_sample = little2big_u16(body + 14);
+
+  // cbSize, valid bits, channel mask and then the sub format GUID
+  if ((file->audio_format == WAV_FORMAT_EXTENSIBLE) && (size >= 40)) {
+    file->audio_format = little2big_u16(body + 24);
+  }
+
+  return WAV_OK;
+}
 
-  file.data = data_ptr;
-  file.data_length = file.header.data_size;
+// Read the first loop of the smpl chunk body
+static void parse_smpl(uint8_t const* body, uint32_t size, WAVFile* file) {
+  if (size < WAV_SMPL_SIZE + WAV_SMPL_LOOP_SIZE) {
+    return;
+  }
+
+  uint32_t loops = little2big_u32(body + 28);
+  if (loops == 0) {
+    return;
+  }
+
+  // cue point id and type come before the loop points, the end is inclusive
+  uint8_t const* loop = body + WAV_SMPL_SIZE;
+  uint32_t start = little2big_u32(loop + 8);
+  uint32_t end = little2big_u32(loop + 12);
+
+  if ((end < start) || (end == UINT32_MAX)) {
+    return;
+  }
+
+  file->loop_start = start;
+  file->loop_end = end + 1;
+  file->loop_play_count = little2big_u32(loop + 20);
+}
 
-  return file;
-}
\ No newline at end of file
+// Walk the chunks of the WAV file of at most size bytes and fill WAVFile with pointers
+// into the file
+WAVResult WAV_ParseFile(uint8_t const* data, size_t size, WAVFile* file) {
+  memset(file, 0, sizeof(*file));
+
+  if ((size < 12) || !is_chunk(data, "RIFF") || !is_chunk(data + 8, "WAVE")) {
+    return WAV_ERROR_NOT_RIFF;
+  }
+
+  // the RIFF chunk may be shorter than the memory it is in, never longer.
+  // Recorders that stream the data leave the size at 0 or 0xFFFFFFFF,
+  // the RIFF chunk then takes the rest of the memory like the data chunk
+  uint32_t riff_size = little2big_u32(data + 4);
+  if ((riff_size == 0) || (riff_size > size - WAV_CHUNK_HEADER_SIZE)) {
+    riff_size = (uint32_t)(size - WAV_CHUNK_HEADER_SIZE);
+  }
+  if (riff_size < 4) {
+    return WAV_ERROR_NOT_RIFF;
+  }
+
+  // the offsets are from the start of the file and never pass end
+  size_t end = WAV_CHUNK_HEADER_SIZE + riff_size;
+  size_t pos = 12;
+  int has_fmt = 0;
+  int has_data = 0;
+
+  while (end - pos >= WAV_CHUNK_HEADER_SIZE) {
+    uint8_t const* chunk = data + pos;
+    uint8_t const* body = chunk + WAV_CHUNK_HEADER_SIZE;
+    uint32_t chunk_size = little2big_u32(chunk + 4);
+    size_t left = end - pos - WAV_CHUNK_HEADER_SIZE;
+
+    if (is_chunk(chunk, "data")) {
+      // recorders that stream the data may leave the size unset, the data takes the rest of the file
+      if (chunk_size > left) {
+        chunk_size = (uint32_t)left;
+      }
+      file->data = body;
+      file->data_length = chunk_size;
+      has_data = 1;
+    }
+
+    if (chunk_size > left) {
+      return WAV_ERROR_TRUNCATED;
+    }
+
+    if (is_chunk(chunk, "fmt ")) {
+      WAVResult result = parse_fmt(body, chunk_size, file);
+      if (result != WAV_OK) {
+        return result;
+      }
+      has_fmt = 1;
+    } else if (is_chunk(chunk, "fact") && (chunk_size >= 4)) {
+      // the number of samples of compressed audio
+      file->sample_count = little2big_u32(body);
+    } else if (is_chunk(chunk, "smpl")) {
+      parse_smpl(body, chunk_size, file);
+    }
+
+    // chunks are padded to an even size, the padding is not in the chunk size
+    size_t skip = WAV_CHUNK_HEADER_SIZE + (size_t)chunk_size + (chunk_size & 1);
+    if (skip > end - pos) {
+      break;
+    }
+    pos += skip;
+  }
+
+  if (!has_fmt) {
+    return WAV_ERROR_NO_FMT;
+  }
+
+  // the smpl chunk usually comes after the data chunk, so the whole file is walked
+  return has_data ? WAV_OK : WAV_ERROR_NO_DATA;
+}
@@ -3,25 +3,52 @@
 #include <stddef.h>
 #include <stdint.h>
 
-// Normalized WAV file header structure
-typedef struct WAVHeader_t {
-  // Should contain the letters "RIFF"
-  char file_id[5];
+// PCM audio, signed 16-bit or unsigned 8-bit samples
+#define WAV_FORMAT_PCM 0x0001
 
-  // The size of entire file in bytes, minus 8 bytes for chunk_id and
-  // chunk_size.
-  uint32_t file_size;
+// G.711 A-law audio, 8-bit codes
+#define WAV_FORMAT_ALAW 0x0006
 
-  // Should contain the letters "WAVE"
-  char format[5];
+// G.711 mu-law audio, 8-bit codes
+#define WAV_FORMAT_MULAW 0x0007
 
-  // Should contain the letters "fmt "
-  char subchunk_id[5];
+// IMA ADPCM audio, 4-bit codes in blocks of block_align bytes
+#define WAV_FORMAT_IMA_ADPCM 0x0011
 
-  // 16 for PCM. This is the size of the rest of the sunchunk which follows this
-  // number.
-  uint32_t subchunk_size;
+// DAC-native audio, 12-bit DAC values 0-4095 right aligned in 16-bit words.
+// DMA sends them straight to the DAC 12-bit right aligned data register.
+#define WAV_FORMAT_DAC12R 0xDAC1
 
+// DAC-native audio, 16-bit offset binary values (signed PCM with the sign bit flipped).
+// DMA sends them straight to the DAC 12-bit left aligned data register.
+#define WAV_FORMAT_DAC12L 0xDAC2
+
+// Lossless audio, 16-bit samples coded with fixed linear prediction and Rice-coded residuals
+// in frames of block_align samples. See lossless.h.
+#define WAV_FORMAT_LOSSLESS 0xDAC3
+
+// WAVE_FORMAT_EXTENSIBLE, the format tag is in the first two bytes of the sub format GUID
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+
+// Results of WAV_ParseFile
+typedef enum WAVResult_t {
+  WAV_OK = 0,
+
+  // Doesn't start with "RIFF" and "WAVE"
+  WAV_ERROR_NOT_RIFF,
+
+  // A chunk goes past the end of the file
+  WAV_ERROR_TRUNCATED,
+
+  // No fmt chunk or it's too short
+  WAV_ERROR_NO_FMT,
+
+  // No data chunk
+  WAV_ERROR_NO_DATA,
+} WAVResult;
+
+// WAV file parsed in place. Nothing is copied, the pointers point into the file.
+typedef struct WAVFile_t {
   // PCM = 1, values other than 1 indicate some form of compression
   uint16_t audio_format;
 
@@ -35,34 +62,34 @@ typedef struct WAVHeader_t {
   uint32_t byte_rate;
 
   // number of channels * bits per sample / 8. Number of bytes for one sample
-  // including all channels.
+  // including all channels. The block size of the block based formats.
   uint16_t block_align;
 
   // self-explanatory. BITS, not BYTES.
   uint16_t bits_per_sample;
 
-  // Should contain the letters "data"
-  char data_id[5];
-
-  // number of samples * number of channels * bits per sample / 8
-  // Actual number of bytes in the sound data.
-  uint32_t data_size;
-} WAVHeader;
-
-// WAV file with header and pointer to data
-typedef struct WAVFile_t {
-  // WAV header (copy re-constructed from the file with proper byte aligment)
-  WAVHeader header;
+  // The body of the fmt chunk and its size, 16 for PCM, 20 for IMA ADPCM
+  uint8_t const* fmt;
+  uint32_t fmt_size;
 
   // Pointer to audio data
   uint8_t const* data;
 
-  // Length of data, copy of header.data_size field
+  // Actual number of bytes in the sound data
   uint32_t data_length;
+
+  // Number of samples from the fact chunk of compressed formats, 0 if there is no fact chunk
+  uint32_t sample_count;
+
+  // The first loop of the smpl chunk: the first sample of the loop, the sample after
+  // the last one and how many times to play it (0 is endless). loop_end is 0 if there is no loop.
+  uint32_t loop_start;
+  uint32_t loop_end;
+  uint32_t loop_play_count;
 } WAVFile;
 
-// Parse the header of WAV file and return WAVFile structure with header and
-// pointer to data
-WAVFile WAV_ParseFileData(uint8_t const* data);
+// Walk the chunks of the WAV file of at most size bytes and fill WAVFile with pointers
+// into the file. The unknown chunks (LIST, cue, etc.) are skipped.
+WAVResult WAV_ParseFile(uint8_t const* data, size_t size, WAVFile* file);
 
-#endif
\ No newline at end of file
+#endif
@@ -6,27 +6,46 @@
 
 #include "stm32lpm.h"
 
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(stm32lpm, CONFIG_STM32LPM_LOG_LEVEL);
+
+static void stm32lpm_pin_handler(const struct device *port, struct gpio_callback *cb, uint32_t pins);
+
 /*
- * Inits a wakeup gpio pin
+ * Inits a wakeup gpio pin, its interrupt posts the pin events on both edges
  */
-static int stm32lpm_init_wakeup_gpio(const struct gpio_dt_spec *wakeup_gpio)
+static int stm32lpm_init_wakeup_gpio(const struct device *dev, int index)
 {
+    const struct stm32lpm_config *config = (const struct stm32lpm_config *)dev->config;
+    struct stm32lpm_data *data = (struct stm32lpm_data *)dev->data;
+    const struct gpio_dt_spec *wakeup_gpio = &config->wakeup_gpios[index];
+    struct stm32lpm_pin_callback *pin_cb = &data->pin_cbs[index];
     int ret = 0;
 
     if (!gpio_is_ready_dt(wakeup_gpio)) {
-        printk("Error: button device %d is not ready\n", wakeup_gpio->pin);
+        LOG_ERR("button device %d is not ready", wakeup_gpio->pin);
         return 1;
     }
 
     ret = gpio_pin_configure_dt(wakeup_gpio, GPIO_INPUT);
     if (ret != 0) {
-        printk("Error %d: failed to configure %s pin %d\n", ret, wakeup_gpio->port->name, wakeup_gpio->pin);
+        LOG_ERR("Error %d: failed to configure %s pin %d", ret, wakeup_gpio->port->name, wakeup_gpio->pin);
         return 1;
     }
 
-    ret = gpio_pin_interrupt_configure_dt(wakeup_gpio, GPIO_INT_EDGE_RISING);
+    pin_cb->dev = dev;
+    pin_cb->index = index;
+    gpio_init_callback(&pin_cb->cb, stm32lpm_pin_handler, BIT(wakeup_gpio->pin));
+
+    ret = gpio_add_callback(wakeup_gpio->port, &pin_cb->cb);
     if (ret != 0) {
-        printk("Error %d: failed to configure interrupt on %s pin %d\n", ret, wakeup_gpio->port->name, wakeup_gpio->pin);
+        LOG_ERR("Error %d: failed to add the callback on %s pin %d", ret, wakeup_gpio->port->name, wakeup_gpio->pin);
+        return 1;
+    }
+
+    ret = gpio_pin_interrupt_configure_dt(wakeup_gpio, GPIO_INT_EDGE_BOTH);
+    if (ret != 0) {
+        LOG_ERR("Error %d: failed to configure interrupt on %s pin %d", ret, wakeup_gpio->port->name, wakeup_gpio->pin);
         return 1;   
     }
 
@@ -51,30 +70,135 @@ static struct gpio_dt_spec* stm32lpm_get_wakeup_gpio(const struct device *dev, i
 }
 
 /*
- * Sets the Standby mode
+ * Gives access to the RTC registers and the backup registers
+ */
+static void stm32lpm_enable_backup_access(void)
+{
+    LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_PWR);
+    LL_PWR_EnableBkUpAccess();
+    LL_APB1_GRP1_EnableClock(LL_APB1_GRP1_PERIPH_RTCAPB);
+}
+
+/*
+ * Starts the RTC wakeup timer, it wakes the system from the Standby mode after the timeout
  */
-static int stm32lpm_enter_standby(const struct device *dev)
+static void stm32lpm_rtc_wakeup_start(uint32_t timeout_s)
 {
+    stm32lpm_enable_backup_access();
+
+    //LSI keeps running in the Standby mode
+    if (LL_RCC_IsEnabledRTC() == 0) {
+        LL_RCC_LSI_Enable();
+        while (LL_RCC_LSI_IsReady() == 0) {
+        }
+
+        LL_RCC_SetRTCClockSource(LL_RCC_RTC_CLKSOURCE_LSI);
+        LL_RCC_EnableRTC();
+    }
+
+    LL_RTC_DisableWriteProtection(RTC);
+
+    //the 1 Hz clock of the wakeup timer
+    LL_RTC_EnableInitMode(RTC);
+    while (LL_RTC_IsActiveFlag_INIT(RTC) == 0) {
+    }
+    LL_RTC_SetAsynchPrescaler(RTC, STM32LPM_RTC_ASYNCH_PREDIV);
+    LL_RTC_SetSynchPrescaler(RTC, STM32LPM_RTC_SYNCH_PREDIV);
+    LL_RTC_DisableInitMode(RTC);
+
+    LL_RTC_WAKEUP_Disable(RTC);
+    while (LL_RTC_IsActiveFlag_WUTW(RTC) == 0) {
+    }
+
+    LL_RTC_WAKEUP_SetClock(RTC, LL_RTC_WAKEUPCLOCK_CKSPRE);
+    LL_RTC_WAKEUP_SetAutoReload(RTC, timeout_s - 1);
+    LL_RTC_ClearFlag_WUT(RTC);
+    LL_RTC_EnableIT_WUT(RTC);
+    LL_RTC_WAKEUP_Enable(RTC);
+
+    LL_RTC_EnableWriteProtection(RTC);
+
+    //the wakeup timer wakes the system through the internal wakeup line
+    LL_PWR_EnableInternWU();
+}
+
+/*
+ * Stops the RTC wakeup timer after the wait for a release
+ */
+static void stm32lpm_rtc_wakeup_stop(void)
+{
+    LL_PWR_DisableInternWU();
+
+    LL_RTC_DisableWriteProtection(RTC);
+    LL_RTC_DisableIT_WUT(RTC);
+    LL_RTC_WAKEUP_Disable(RTC);
+    LL_RTC_ClearFlag_WUT(RTC);
+    LL_RTC_EnableWriteProtection(RTC);
+}
+
+/*
+ * Gets the wakeup pins that are active now, the bits of LL_PWR_WAKEUP_PIN*
+ */
+static uint32_t stm32lpm_active_pins(const struct device *dev)
+{
+    const struct stm32lpm_config *config = (const struct stm32lpm_config *)dev->config;
     const struct stm32lpm_data *data = (struct stm32lpm_data *)dev->data;
+    uint32_t active = 0;
 
-    printk("Entering Standby\n");
+    for (int i = 0; i < ARRAY_SIZE(config->wakeup_gpios); i++) {
+        if (gpio_pin_get_dt(&config->wakeup_gpios[i]) > 0) {
+            active |= data->wakeup_pins[i];
+        }
+    }
 
-    // Clear all wake up Flags
-    LL_PWR_ClearFlag_WU();
+    return active;
+}
+
+/*
+ * Sets the Standby or Shutdown mode, one of LL_PWR_MODE_*.
+ * The released pins wake the system when they go low, the other pins when they go high
+ */
+static int stm32lpm_enter_standby(const struct device *dev, uint32_t released_pins, uint32_t power_mode)
+{
+    const struct stm32lpm_data *data = (struct stm32lpm_data *)dev->data;
 
     for (int i = 0; i < sizeof(data->wakeup_pins)/sizeof(uint32_t); i++) {
         // Disable all used wakeup sources
         LL_PWR_DisableWakeUpPin(data->wakeup_pins[i]);
 
         // Enable the wakeup pin irq polarity
-        LL_PWR_SetWakeUpPinPolarityHigh(data->wakeup_pins[i]);
+        if ((data->wakeup_pins[i] & released_pins) != 0) {
+            LL_PWR_SetWakeUpPinPolarityLow(data->wakeup_pins[i]);
+        } else {
+            LL_PWR_SetWakeUpPinPolarityHigh(data->wakeup_pins[i]);
+        }
 
         // Enable wakeup pin
         LL_PWR_EnableWakeUpPin(data->wakeup_pins[i]);
     }
 
-     // Set STANDBY mode when CPU enters deepsleep
-     LL_PWR_SetPowerMode(LL_PWR_MODE_STANDBY);
+    // Clear all wake up Flags, changing the polarity can set them
+    LL_PWR_ClearFlag_WU();
+
+    //a pin released before the flags were cleared has lost its wakeup event
+    uint32_t lost_pins = released_pins & ~stm32lpm_active_pins(dev);
+
+    if (lost_pins != 0) {
+        LOG_INF("Wakeup pins 0x%02lx have been released before the Standby mode", (unsigned long)lost_pins);
+        return -EAGAIN;
+    }
+
+    LOG_INF("Entering %s", (power_mode == LL_PWR_MODE_SHUTDOWN) ? "Shutdown" : "Standby");
+
+    //a rejected wake goes back into the same mode
+    stm32lpm_enable_backup_access();
+    LL_RTC_BAK_SetRegister(RTC, STM32LPM_BKP_POWER_MODE, power_mode);
+
+    //the deferred messages would be lost in the Standby mode, send them now
+    LOG_PANIC();
+
+     // Set STANDBY or SHUTDOWN mode when CPU enters deepsleep
+     LL_PWR_SetPowerMode(power_mode);
 
     // Set SLEEPDEEP bit of Cortex System Control Register
     LL_LPM_EnableDeepSleep();
@@ -89,19 +213,108 @@ static int stm32lpm_enter_standby(const struct device *dev)
     return 0;
 }
 
+/*
+ * Sets the Stop2 mode, the RAM and the registers are kept.
+ * Any enabled EXTI interrupt wakes the system up, the wakeup gpios included,
+ * and the interrupt runs after the clocks have been restored.
+ */
+static int stm32lpm_enter_stop2(const struct device *dev)
+{
+    ARG_UNUSED(dev);
+
+    LOG_INF("Entering Stop2");
+
+    //PRIMASK, unlike irq_lock, lets a pending interrupt end WFI
+    __disable_irq();
+
+    // Set STOP2 mode when CPU enters deepsleep
+    LL_PWR_SetPowerMode(LL_PWR_MODE_STOP2);
+
+    //the system restarts from HSI16, it's ready in a few microseconds
+    LL_RCC_SetClkAfterWakeFromStop(LL_RCC_STOP_WAKEUPCLOCK_HSI);
+
+    // Set SLEEPDEEP bit of Cortex System Control Register
+    LL_LPM_EnableDeepSleep();
+
+    __DSB();
+    __WFI();
+
+    //the next WFI of the idle thread is a plain sleep
+    LL_LPM_EnableSleep();
+
+    //the PLL is off after Stop2, set the system clock up again
+    stm32_clock_control_init(NULL);
+
+    __enable_irq();
+
+    LOG_INF("Woken up from Stop2");
+
+    return 0;
+}
+
 /**
   * Switches the power state
   * @param dev Pointer to device structure
  */
 static int stm32lpm_state_set(const struct device *dev, enum pm_state state, uint8_t substate_id)
 {
-    ARG_UNUSED(dev);
+    if ((state == PM_STATE_STANDBY) && (substate_id == STM32PM_SUBSTATE_STANDBY)) {
+        return stm32lpm_enter_standby(dev, 0, LL_PWR_MODE_STANDBY);
+    }
 
-    if (state == PM_STATE_STANDBY) {
-        stm32lpm_enter_standby(dev);
+    if ((state == PM_STATE_STANDBY) && (substate_id == STM32PM_SUBSTATE_SHUTDOWN)) {
+        return stm32lpm_enter_standby(dev, 0, LL_PWR_MODE_SHUTDOWN);
     }
 
-    return 0;
+    if ((state == PM_STATE_SUSPEND_TO_IDLE) && (substate_id == STM32PM_SUBSTATE_STOP2)) {
+        return stm32lpm_enter_stop2(dev);
+    }
+
+    return -ENOTSUP;
+}
+
+/*
+ * Goes into the Standby mode until any of the active wakeup pins is released or the timeout has passed
+ */
+static int stm32lpm_standby_until_release(const struct device *dev, uint32_t timeout_s)
+{
+    uint32_t active_pins = stm32lpm_active_pins(dev);
+
+    if (active_pins == 0) {
+        return -ENODEV;
+    }
+
+    //the wakeup timer counts up to 65536 seconds
+    if ((timeout_s == 0) || (timeout_s > 0x10000)) {
+        return -EINVAL;
+    }
+
+    LOG_INF("Waiting in Standby for the release of wakeup pins 0x%02lx, seconds: %lu", 
+        (unsigned long)active_pins, (unsigned long)timeout_s);
+
+    stm32lpm_rtc_wakeup_start(timeout_s);
+
+    //the RAM is lost in the Standby mode, the backup register tells the next start what it has waited for
+    LL_RTC_BAK_SetRegister(RTC, STM32LPM_BKP_RELEASE, STM32LPM_RELEASE_MAGIC | active_pins);
+
+    //LSI keeps the RTC running in the Standby mode but not in the Shutdown mode
+    int ret = stm32lpm_enter_standby(dev, active_pins, LL_PWR_MODE_STANDBY);
+
+    //the pin has been released already, there is nothing to wait for
+    LL_RTC_BAK_SetRegister(RTC, STM32LPM_BKP_RELEASE, 0);
+    stm32lpm_rtc_wakeup_stop();
+
+    return ret;
+}
+
+/*
+ * Gets why the system has started
+ */
+static enum stm32pm_wake_cause stm32lpm_wake_cause_get(const struct device *dev)
+{
+    const struct stm32lpm_data *data = (struct stm32lpm_data *)dev->data;
+
+    return data->wake_cause;
 }
 
 /*
@@ -111,7 +324,7 @@ static int32_t stm32lpm_wakeup_pin_get(const struct device *dev)
 {
     const struct stm32lpm_data *data = (struct stm32lpm_data *)dev->data;
 
-    printk("Getting the wakeup pin that has awaken the system\n");
+    LOG_DBG("Getting the wakeup pin that has awaken the system");
 
     return data->active_wakeup_pin;
 }
@@ -124,17 +337,163 @@ static int stm32lpm_wakeup_pin_active(const struct device *dev)
     const struct stm32lpm_data *data = (struct stm32lpm_data *)dev->data;
     int is_active = 0;
 
-    printk("Checking if the wakeup pin that has awaken the system is still active\n");
+    LOG_DBG("Checking if the wakeup pin that has awaken the system is still active");
 
     struct gpio_dt_spec *wakeup_gpio = stm32lpm_get_wakeup_gpio(dev, data->active_wakeup_pin);
-    printk("Wakeup Pin: %u, gpio name: %s\n", wakeup_gpio->pin, wakeup_gpio->port->name); 
+
+    if (wakeup_gpio == NULL) {
+        return 0;
+    }
+
+    LOG_DBG("Wakeup Pin: %u, gpio name: %s", wakeup_gpio->pin, wakeup_gpio->port->name); 
 
     is_active = gpio_pin_get_dt(wakeup_gpio);
-    printk("Wakeup Pin active: %d\n", is_active); 
+    LOG_DBG("Wakeup Pin active: %d", is_active); 
     
     return is_active;
 }
 
+/*
+ * Gets every wakeup pin that has woken the system and the pins that are active now
+ */
+static int stm32lpm_wakeup_pins_get(const struct device *dev, struct stm32pm_wakeup_pins *pins)
+{
+    const struct stm32lpm_data *data = (struct stm32lpm_data *)dev->data;
+
+    pins->woken = data->woken_pins;
+    pins->active = stm32lpm_active_pins(dev);
+
+    return 0;
+}
+
+/*
+ * The GPIO interrupt of a wakeup pin on both edges
+ */
+static void stm32lpm_pin_handler(const struct device *port, struct gpio_callback *cb, uint32_t pins)
+{
+    struct stm32lpm_pin_callback *pin_cb = CONTAINER_OF(cb, struct stm32lpm_pin_callback, cb);
+    const struct device *dev = pin_cb->dev;
+    const struct stm32lpm_config *config = (const struct stm32lpm_config *)dev->config;
+    struct stm32lpm_data *data = (struct stm32lpm_data *)dev->data;
+
+    ARG_UNUSED(port);
+    ARG_UNUSED(pins);
+
+    uint32_t wakeup_pin = data->wakeup_pins[pin_cb->index];
+    int is_active = gpio_pin_get_dt(&config->wakeup_gpios[pin_cb->index]);
+
+    if (is_active > 0) {
+        k_event_post(&data->pin_events, STM32PM_EVENT_ACTIVE(wakeup_pin));
+        return;
+    }
+
+    k_event_post(&data->pin_events, STM32PM_EVENT_RELEASED(wakeup_pin));
+
+    stm32pm_release_callback_t callback = data->release_callback;
+
+    if (callback != NULL) {
+        callback(dev, wakeup_pin, data->release_user_data);
+    }
+}
+
+/*
+ * Sets the callback for the release of the wakeup pins
+ */
+static int stm32lpm_wakeup_pin_release_callback_set(const struct device *dev,
+    stm32pm_release_callback_t callback, void *user_data)
+{
+    struct stm32lpm_data *data = (struct stm32lpm_data *)dev->data;
+
+    //the pin interrupt reads the callback and then the user data
+    unsigned int key = irq_lock();
+
+    data->release_callback = callback;
+    data->release_user_data = user_data;
+
+    irq_unlock(key);
+
+    return 0;
+}
+
+/*
+ * Waits for any of the pin events, the events that have been returned are cleared
+ */
+static uint32_t stm32lpm_pin_event_wait(const struct device *dev, uint32_t events, k_timeout_t timeout)
+{
+    struct stm32lpm_data *data = (struct stm32lpm_data *)dev->data;
+
+    uint32_t posted = k_event_wait(&data->pin_events, events, false, timeout) & events;
+
+    k_event_clear(&data->pin_events, posted);
+
+    return posted;
+}
+
+/*
+ * Reads the pins debounce-samples times over debounce-window-ms
+ *
+ * @return the pins that have been at the level every time, active or inactive
+ */
+static uint32_t stm32lpm_debounce(const struct device *dev, uint32_t pins, bool active)
+{
+    const struct stm32lpm_config *config = (const struct stm32lpm_config *)dev->config;
+    uint32_t held = pins;
+
+    if ((pins == 0) || (config->debounce_samples == 0)) {
+        return pins;
+    }
+
+    uint32_t interval_us = (config->debounce_window_ms * 1000) / config->debounce_samples;
+
+    //the kernel isn't running yet, wait actively
+    for (uint32_t i = 0; (i < config->debounce_samples) && (held != 0); i++) {
+        k_busy_wait(interval_us);
+
+        uint32_t active_pins = stm32lpm_active_pins(dev);
+        held &= active ? active_pins : ~active_pins;
+    }
+
+    return held;
+}
+
+/*
+ * Gets the low-power mode the system has gone into last, LL_PWR_MODE_STANDBY or LL_PWR_MODE_SHUTDOWN
+ */
+static uint32_t stm32lpm_last_power_mode(void)
+{
+    uint32_t power_mode = LL_RTC_BAK_GetRegister(RTC, STM32LPM_BKP_POWER_MODE);
+
+    return (power_mode == LL_PWR_MODE_SHUTDOWN) ? LL_PWR_MODE_SHUTDOWN : LL_PWR_MODE_STANDBY;
+}
+
+/*
+ * Counts the glitch and goes back into the low-power mode it has woken the system from,
+ * the pins in the release wait stay armed and the RTC keeps counting
+ */
+static void stm32lpm_reject_wake(const struct device *dev, uint32_t waited_pins)
+{
+    uint32_t rejected = LL_RTC_BAK_GetRegister(RTC, STM32LPM_BKP_REJECTED) + 1;
+
+    LL_RTC_BAK_SetRegister(RTC, STM32LPM_BKP_REJECTED, rejected);
+
+    LOG_WRN("Spurious wake rejected, count: %lu", (unsigned long)rejected);
+
+    //the wait for a release is always in the Standby mode, the RTC needs LSI
+    uint32_t power_mode = (waited_pins != 0) ? LL_PWR_MODE_STANDBY : stm32lpm_last_power_mode();
+
+    stm32lpm_enter_standby(dev, waited_pins, power_mode);
+}
+
+/*
+ * Gets how many wakes have been rejected as glitches since the power on
+ */
+static uint32_t stm32lpm_rejected_wakes_get(const struct device *dev)
+{
+    ARG_UNUSED(dev);
+
+    return LL_RTC_BAK_GetRegister(RTC, STM32LPM_BKP_REJECTED);
+}
+
 
 /**
  * @brief Inits the driver
@@ -145,14 +504,14 @@ static int stm32lpm_wakeup_pin_active(const struct device *dev)
  */
 static int stm32lpm_init(const struct device *dev)
 {
-    printk("Configuring STM32 PM\n");
+    LOG_DBG("Configuring STM32 PM");
 
     struct stm32lpm_config *config = (struct stm32lpm_config *)dev->config;
     struct stm32lpm_data *data = (struct stm32lpm_data *)dev->data;
 
     //assign wakeup_pins from GPIOs for STM32L452
     for (int i = 0; i < sizeof(config->wakeup_gpios)/sizeof(struct gpio_dt_spec); i++) {
-        printk("Wakeup Pin: %u, gpio name: %s\n", config->wakeup_gpios[i].pin, config->wakeup_gpios[i].port->name); 
+        LOG_DBG("Wakeup Pin: %u, gpio name: %s", config->wakeup_gpios[i].pin, config->wakeup_gpios[i].port->name); 
 
         switch(config->wakeup_gpios[i].pin) {
             //gpioa 0
@@ -177,57 +536,82 @@ static int stm32lpm_init(const struct device *dev)
                 break;
         }
 
-        printk("Wakeup Pin number: %d\n", data->wakeup_pins[i]); 
+        LOG_DBG("Wakeup Pin number: %d", data->wakeup_pins[i]); 
     }
 
-    printk("In init after\n");
-
     // Check if the system was resumed from StandBy mode
     if (LL_PWR_IsActiveFlag_SB() != 0) { 
         // Clear Standby flag
         LL_PWR_ClearFlag_SB(); 
 
-        printk("Resumed from the Standby mode\n");
+        LOG_INF("Resumed from the Standby mode");
     }
 
-    printk("In init after 2\n");
+    //posted by the pin interrupts
+    k_event_init(&data->pin_events);
 
-    // Check and Clear the Wakeup pins
-    if (LL_PWR_IsActiveFlag_WU1() != 0) {
-        printk("Wakeup pin 1 was active\n");
-        data->active_wakeup_pin = LL_PWR_WAKEUP_PIN1;
-    }
-    else if (LL_PWR_IsActiveFlag_WU2() != 0) {
-        printk("Wakeup pin 2 was active\n");
-        data->active_wakeup_pin = LL_PWR_WAKEUP_PIN2;
-    }
-    else if (LL_PWR_IsActiveFlag_WU3() != 0) {
-        printk("Wakeup pin 3 was active\n");
-        data->active_wakeup_pin = LL_PWR_WAKEUP_PIN3;
+    //the pins are read to validate the wake
+    for (int i = 0; i < sizeof(config->wakeup_gpios)/sizeof(struct gpio_dt_spec); i++) {
+        stm32lpm_init_wakeup_gpio(dev, i);
     }
-    else if (LL_PWR_IsActiveFlag_WU4() != 0) {
-        printk("Wakeup pin 4 was active\n");
-        data->active_wakeup_pin = LL_PWR_WAKEUP_PIN4;
+
+    //if the system has waited in the Standby mode for the release of pins
+    stm32lpm_enable_backup_access();
+    uint32_t release_wait = LL_RTC_BAK_GetRegister(RTC, STM32LPM_BKP_RELEASE);
+    uint32_t waited_pins = 0;
+
+    if ((release_wait & STM32LPM_RELEASE_MAGIC_MASK) == STM32LPM_RELEASE_MAGIC) {
+        waited_pins = release_wait & ~STM32LPM_RELEASE_MAGIC_MASK;
     }
-    else if (LL_PWR_IsActiveFlag_WU5() != 0) {
-        printk("Wakeup pin 5 was active\n");
-        data->active_wakeup_pin = LL_PWR_WAKEUP_PIN5;
+
+    // Check the Wakeup pins, every flag is kept so no signal is lost
+    // the flags of the wakeup pins are at the bits of the pins
+    uint32_t flags = LL_PWR_ReadReg(SR1) & STM32LPM_WAKEUP_PINS;
+    bool timeout = (waited_pins != 0) && (LL_PWR_IsActiveFlag_InternWU() != 0);
+
+    //a release and a new signal must both keep their level through the debounce window
+    uint32_t released_pins = stm32lpm_debounce(dev, flags & waited_pins, false);
+    data->woken_pins = stm32lpm_debounce(dev, flags & ~waited_pins, true);
+
+    if ((flags != 0) && (released_pins == 0) && (data->woken_pins == 0) && !timeout) {
+        //a glitch, the wait for the release goes on if there has been one
+        stm32lpm_reject_wake(dev, waited_pins);
     }
 
-    printk("In init after 3\n");
+    data->wake_cause = STM32PM_WAKE_RESET;
 
-    //clear all Wakeup pins
-    LL_PWR_ClearFlag_WU();
+    if (released_pins != 0) {
+        LOG_INF("Wakeup pins 0x%02lx have been released", (unsigned long)released_pins);
+        data->wake_cause = STM32PM_WAKE_RELEASE;
+    } else if (timeout) {
+        LOG_INF("Wakeup pins 0x%02lx haven't been released in time", (unsigned long)waited_pins);
+        data->wake_cause = STM32PM_WAKE_TIMEOUT;
+    }
 
-    printk("In init after 4\n");
+    if (waited_pins != 0) {
+        LL_RTC_BAK_SetRegister(RTC, STM32LPM_BKP_RELEASE, 0);
+        stm32lpm_rtc_wakeup_stop();
+    }
 
+    for (int i = 0; i < 5; i++) {
+        if ((data->woken_pins & BIT(i)) != 0) {
+            LOG_INF("Wakeup pin %d was active", i + 1);
+        }
+    }
 
-    for (int i = 0; i < sizeof(config->wakeup_gpios)/sizeof(struct gpio_dt_spec); i++) {
-        struct gpio_dt_spec *wakeup_gpio = &config->wakeup_gpios[i];
+    //the first pin, the same order as before
+    if (data->woken_pins != 0) {
+        data->active_wakeup_pin = BIT(find_lsb_set(data->woken_pins) - 1);
+    }
 
-        stm32lpm_init_wakeup_gpio(wakeup_gpio);
+    //another pin goes before the release
+    if (data->active_wakeup_pin >= 0) {
+        data->wake_cause = STM32PM_WAKE_PIN;
     }
 
+    //clear all Wakeup pins
+    LL_PWR_ClearFlag_WU();
+
     return 0;
 }
 
@@ -237,15 +621,23 @@ static struct stm32lpm_data stm32lpm_data = {
 
 static struct stm32lpm_config stm32lpm_config = {
     .wakeup_gpios = { DT_FOREACH_PROP_ELEM_SEP(STM32PM_NODE, wakeup_gpios, GPIO_DT_SPEC_GET_BY_IDX, (,)) },
+    .debounce_samples = DT_PROP(STM32PM_NODE, debounce_samples),
+    .debounce_window_ms = DT_PROP(STM32PM_NODE, debounce_window_ms),
 };
 
 static const struct stm32pm_driver_api stm32lpm_driver_api = {
     .state_set = stm32lpm_state_set,
     .wakeup_pin_get = stm32lpm_wakeup_pin_get,
     .wakeup_pin_active = stm32lpm_wakeup_pin_active,
+    .wakeup_pin_release_callback_set = stm32lpm_wakeup_pin_release_callback_set,
+    .pin_event_wait = stm32lpm_pin_event_wait,
+    .standby_until_release = stm32lpm_standby_until_release,
+    .wake_cause_get = stm32lpm_wake_cause_get,
+    .wakeup_pins_get = stm32lpm_wakeup_pins_get,
+    .rejected_wakes_get = stm32lpm_rejected_wakes_get,
 };
 
 DEVICE_DT_INST_DEFINE(0, &stm32lpm_init,
     NULL, &stm32lpm_data,
-    &stm32lpm_config, PRE_KERNEL_1,
+    &stm32lpm_config, PRE_KERNEL_2,
     CONFIG_KERNEL_INIT_PRIORITY_DEVICE, &stm32lpm_driver_api);
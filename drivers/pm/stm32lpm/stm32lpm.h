@@ -11,10 +11,10 @@
 #include <zephyr/kernel.h>
 #include <zephyr/pm/pm.h>
 #include <zephyr/pm/state.h>
-#include <zephyr/sys/printk.h>
 #include <zephyr/device.h>
 #include <zephyr/devicetree.h>
 #include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/clock_control/stm32_clock_control.h>
 
 #include <stm32_ll_utils.h>
 #include <stm32_ll_bus.h>
@@ -22,24 +22,63 @@
 #include <stm32_ll_pwr.h>
 #include <stm32_ll_rcc.h>
 #include <stm32_ll_system.h>
+#include <stm32_ll_rtc.h>
 #include "stm32_ll_gpio.h"
 
-#include <zephyr/logging/log.h>
-LOG_MODULE_REGISTER(stm32lpm, CONFIG_KERNEL_LOG_LEVEL);
-
 #include "driver_stm32pm.h"
 
 #define STM32PM_NODE DT_INST(0, st_stm32pm)
 
+//the bits of all wakeup pins, the wakeup flags are at the same bits
+#define STM32LPM_WAKEUP_PINS (LL_PWR_WAKEUP_PIN1 | LL_PWR_WAKEUP_PIN2 | LL_PWR_WAKEUP_PIN3 | \
+    LL_PWR_WAKEUP_PIN4 | LL_PWR_WAKEUP_PIN5)
+
+//the RTC backup register that keeps the pins whose release is waited for in the Standby mode
+#define STM32LPM_BKP_RELEASE LL_RTC_BKP_DR0
+//the RTC backup register that counts the rejected wakes
+#define STM32LPM_BKP_REJECTED LL_RTC_BKP_DR1
+
+//the RTC backup register that keeps the low-power mode the system has gone into, one of LL_PWR_MODE_*
+#define STM32LPM_BKP_POWER_MODE LL_RTC_BKP_DR2
+
+//the upper bits of the backup register, the bits of the wakeup pins are in the lower 8 bits
+#define STM32LPM_RELEASE_MAGIC 0x52454C00
+#define STM32LPM_RELEASE_MAGIC_MASK 0xFFFFFF00
+
+//the RTC prescalers that divide the 32 kHz LSI clock to 1 Hz for the wakeup timer
+#define STM32LPM_RTC_ASYNCH_PREDIV 127
+#define STM32LPM_RTC_SYNCH_PREDIV 249
+
 /** @brief Driver config data */
 struct stm32lpm_config {
     struct gpio_dt_spec wakeup_gpios[DT_PROP_LEN(STM32PM_NODE, wakeup_gpios)];
+    //how many times a wakeup pin is read over the window to accept the wake, 0 to accept it at once
+    uint32_t debounce_samples;
+    uint32_t debounce_window_ms;
+};
+
+/** @brief The GPIO callback of a wakeup pin */
+struct stm32lpm_pin_callback {
+    struct gpio_callback cb;
+    const struct device *dev;
+    //the index of the pin in wakeup-gpios
+    int index;
 };
 
 /** @brief Driver instance data */
 struct stm32lpm_data {
     uint32_t wakeup_pins[DT_PROP_LEN(STM32PM_NODE, wakeup_gpios)];
     int32_t active_wakeup_pin;
+    //every wakeup pin that has woken the system, the bits of LL_PWR_WAKEUP_PIN*
+    uint32_t woken_pins;
+    //why the system has started
+    enum stm32pm_wake_cause wake_cause;
+    //the pin interrupts post STM32PM_EVENT_ACTIVE and STM32PM_EVENT_RELEASED
+    struct k_event pin_events;
+    struct stm32lpm_pin_callback pin_cbs[DT_PROP_LEN(STM32PM_NODE, wakeup_gpios)];
+    //called when the active wakeup pin is released
+    stm32pm_release_callback_t release_callback;
+    void *release_user_data;
 };
 
 
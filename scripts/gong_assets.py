@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2024 Farit N
+# SPDX-License-Identifier: Apache-2.0
+#
+# Builds the audio asset blob that is linked into the .audioData flash section.
+#
+# Every asset is a mono 16-bit PCM WAV file that is converted by gong_wav.py
+# into the format the stm32ldac driver plays.
+#
+# The blob starts with the asset directory, all fields are little-endian:
+#
+#   magic    4 bytes  "GONG"
+#   version  16 bits  DIRECTORY_VERSION
+#   count    16 bits  the number of entries
+#
+# and an entry for every asset, the asset ID is the index of the entry:
+#
+#   offset           32 bits  from the start of the blob
+#   length           32 bits  in bytes
+#   sample_count     32 bits
+#   sample_rate      32 bits
+#   loop_start       32 bits
+#   loop_end         32 bits  the sample after the last one, 0 if there is no loop
+#   format           16 bits  the WAV format tag
+#   bits_per_sample  16 bits
+#   block_align      16 bits
+#   loop_count       16 bits  how many times the loop is played in a row
+#
+# The loop comes from the smpl chunk of the WAV file. The loop count is
+# the play count of the loop, or the one given after the format.
+#
+# The encoded samples of the assets follow the directory, 4-byte aligned,
+# without the WAV headers. The generated header has the ID, offset, size,
+# sample rate, format and number of samples of every asset, and for C++
+# the WAV header of every asset that GongAudio.h validates at compile time.
+# The directory layout is in app/include/GongAudio.h as well.
+#
+# Usage: gong_assets.py --blob gong_audio.bin --header gong_audio_assets.h \
+#            NAME=path/to/file.wav:format[:loop_count] ...
+
+import argparse
+import os
+import struct
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+
+from gong_wav import ENCODERS, read_wav, wav_header  # noqa: E402
+
+# the assets start on a word boundary, so DMA can read them with any data size
+ASSET_ALIGN = 4
+
+DIRECTORY_MAGIC = b'GONG'
+DIRECTORY_VERSION = 1
+DIRECTORY_HEADER = struct.Struct('<4sHH')
+DIRECTORY_ENTRY = struct.Struct('<IIIIIIHHHH')
+
+
+def parse_asset(spec):
+    """NAME=path:format[:loop_count]"""
+    loop_count = None
+    try:
+        name, rest = spec.split('=', 1)
+        path, audio_format = rest.rsplit(':', 1)
+        if audio_format.isdigit():
+            loop_count = int(audio_format)
+            path, audio_format = path.rsplit(':', 1)
+    except ValueError:
+        sys.exit(f'{spec}: expected NAME=path:format[:loop_count]')
+
+    if audio_format not in ENCODERS:
+        sys.exit(f'{spec}: unknown format {audio_format}, one of {", ".join(ENCODERS)}')
+
+    if loop_count is not None and loop_count > 0xFFFF:
+        sys.exit(f'{spec}: the loop count is more than 65535')
+
+    return name.upper(), path, audio_format, loop_count
+
+
+def write_if_changed(path, data):
+    """Keeps the file time if nothing has changed, so the dependent sources are not rebuilt"""
+    if os.path.exists(path):
+        with open(path, 'rb') as f:
+            if f.read() == data:
+                return
+
+    os.makedirs(os.path.dirname(os.path.abspath(path)), exist_ok=True)
+    with open(path, 'wb') as f:
+        f.write(data)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Builds the audio asset blob')
+    parser.add_argument('--blob', required=True, help='the binary blob to write')
+    parser.add_argument('--header', required=True, help='the C header to write')
+    parser.add_argument('assets', nargs='+', help='NAME=path/to/file.wav:format')
+    args = parser.parse_args()
+
+    assets = [parse_asset(spec) for spec in args.assets]
+    names = [name for name, _, _, _ in assets]
+    for name in set(names):
+        if names.count(name) > 1:
+            sys.exit(f'{name}: the asset name is used more than once')
+
+    directory_size = DIRECTORY_HEADER.size + len(assets) * DIRECTORY_ENTRY.size
+    directory = DIRECTORY_HEADER.pack(DIRECTORY_MAGIC, DIRECTORY_VERSION, len(assets))
+    blob = bytearray(directory_size)
+
+    lines = [
+        '/*',
+        ' * Generated by scripts/gong_assets.py, do not edit',
+        ' */',
+        '#ifndef GONG_AUDIO_ASSETS_H__',
+        '#define GONG_AUDIO_ASSETS_H__',
+        '',
+        f'#define GONG_AUDIO_DIRECTORY_VERSION {DIRECTORY_VERSION}',
+        '',
+    ]
+
+    wav_headers = []
+
+    for asset_id, (name, path, audio_format, loop_count) in enumerate(assets):
+        sample_rate, samples, loop = read_wav(path)
+        if loop_count is not None:
+            if loop is None:
+                sys.exit(f'{path}: no smpl loop to play {loop_count} times')
+            loop = (loop[0], loop[1], loop_count)
+        elif loop is not None:
+            # 0 is an endless loop, the driver plays it once
+            loop = (loop[0], loop[1], min(loop[2], 0xFFFF))
+        loop_start, loop_end, loop_count = loop or (0, 0, 0)
+
+        encoded = ENCODERS[audio_format](samples)
+        data = encoded.payload
+        block_align = encoded.block_align or encoded.bits // 8
+
+        blob += bytes(-len(blob) % ASSET_ALIGN)
+        offset = len(blob)
+        blob += data
+
+        directory += DIRECTORY_ENTRY.pack(offset, len(data), encoded.sample_count, sample_rate,
+                                          loop_start, loop_end, encoded.audio_format, encoded.bits,
+                                          block_align, loop_count)
+
+        lines += [
+            f'/* {os.path.basename(path)}, {audio_format} */',
+            f'#define GONG_AUDIO_{name} {asset_id}',
+            f'#define GONG_AUDIO_{name}_OFFSET {offset}',
+            f'#define GONG_AUDIO_{name}_SIZE {len(data)}',
+            f'#define GONG_AUDIO_{name}_RATE {sample_rate}',
+            f'#define GONG_AUDIO_{name}_FORMAT 0x{encoded.audio_format:04X}',
+            f'#define GONG_AUDIO_{name}_SAMPLES {encoded.sample_count}',
+            f'#define GONG_AUDIO_{name}_WAV_HEADER gong_audio_{name.lower()}_wav_header',
+            '',
+        ]
+        wav_headers.append((name, wav_header(encoded, sample_rate, loop)))
+
+    blob[:directory_size] = directory
+    blob += bytes(-len(blob) % ASSET_ALIGN)
+
+    lines += [
+        f'#define GONG_AUDIO_COUNT {len(assets)}',
+        f'#define GONG_AUDIO_BLOB_SIZE {len(blob)}',
+        '',
+        '/* X(NAME) for every asset in the ID order */',
+        '#define GONG_AUDIO_ASSET_LIST(X) ' + ' '.join(f'X({name})' for name in names),
+        '',
+        '#ifdef __cplusplus',
+        '#include <stdint.h>',
+        '',
+    ]
+
+    for name, header in wav_headers:
+        lines.append(f'static constexpr uint8_t gong_audio_{name.lower()}_wav_header[] = {{')
+        for pos in range(0, len(header), 12):
+            lines.append('    ' + ' '.join(f'0x{b:02x},' for b in header[pos:pos + 12]))
+        lines += ['};', '']
+
+    lines += [
+        '#endif /* __cplusplus */',
+        '',
+        '#endif',
+        '',
+    ]
+
+    write_if_changed(args.blob, bytes(blob))
+    write_if_changed(args.header, '\n'.join(lines).encode())
+
+
+if __name__ == '__main__':
+    main()
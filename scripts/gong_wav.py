@@ -0,0 +1,400 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2024 Farit N
+# SPDX-License-Identifier: Apache-2.0
+#
+# Converts a mono 16-bit PCM WAV file into one of the formats
+# the stm32ldac driver can play.
+#
+#   pcm16   signed 16-bit PCM, converted to DAC values by the driver
+#   pcm8    unsigned 8-bit PCM, sent by DMA straight to the DAC 8-bit register
+#   dac12r  12-bit DAC values, sent by DMA straight to the DAC 12-bit right aligned register
+#   dac12l  16-bit offset binary, sent by DMA straight to the DAC 12-bit left aligned register
+#   adpcm   IMA ADPCM 4:1, decoded by the driver into the DMA buffer
+#   mulaw   G.711 mu-law 8-bit, expanded by the driver through a table
+#   alaw    G.711 A-law 8-bit, expanded by the driver through a table
+#   lossless  fixed linear prediction and Rice-coded residuals, bit-exact,
+#           decoded by the driver into the DMA buffer
+#
+# The first loop of the smpl chunk is kept: the driver plays it as many times
+# as the loop play count says, without a gap.
+#
+# Usage: gong_wav.py --format dac12l input.wav output.wav
+
+import argparse
+import struct
+import sys
+
+WAV_FORMAT_PCM = 0x0001
+WAV_FORMAT_ALAW = 0x0006
+WAV_FORMAT_MULAW = 0x0007
+WAV_FORMAT_IMA_ADPCM = 0x0011
+WAV_FORMAT_DAC12R = 0xDAC1
+WAV_FORMAT_DAC12L = 0xDAC2
+WAV_FORMAT_LOSSLESS = 0xDAC3
+
+
+def read_wav(path):
+    """Reads a mono 16-bit PCM WAV file, returns the sample rate, the signed samples
+    and the first loop of the smpl chunk as (start, end, play count) or None.
+    The loop end is the sample after the last one."""
+    with open(path, 'rb') as f:
+        data = f.read()
+
+    if data[0:4] != b'RIFF' or data[8:12] != b'WAVE':
+        sys.exit(f'{path}: not a WAV file')
+
+    fmt = None
+    pcm = None
+    loop = None
+    pos = 12
+    while pos + 8 <= len(data):
+        chunk_id = data[pos:pos + 4]
+        chunk_size = struct.unpack_from('<I', data, pos + 4)[0]
+        body = data[pos + 8:pos + 8 + chunk_size]
+
+        if chunk_id == b'fmt ':
+            fmt = struct.unpack_from('<HHIIHH', body)
+        elif chunk_id == b'data':
+            pcm = body
+        elif chunk_id == b'smpl' and len(body) >= 60 and struct.unpack_from('<I', body, 28)[0] > 0:
+            # the loops follow 9 words, the loop end is inclusive
+            _, _, start, end, _, play_count = struct.unpack_from('<6I', body, 36)
+            loop = (start, end + 1, play_count)
+
+        # chunks are padded to an even size
+        pos += 8 + chunk_size + (chunk_size & 1)
+
+    if fmt is None or pcm is None:
+        sys.exit(f'{path}: no fmt or data chunk')
+
+    audio_format, channels, sample_rate, _, _, bits = fmt
+    if audio_format != WAV_FORMAT_PCM or channels != 1 or bits != 16:
+        sys.exit(f'{path}: only mono 16-bit PCM is supported')
+
+    samples = struct.unpack(f'<{len(pcm) // 2}h', pcm[:len(pcm) // 2 * 2])
+
+    if loop is not None and not (loop[0] < loop[1] <= len(samples)):
+        sys.exit(f'{path}: the loop {loop[0]}-{loop[1]} is outside the audio')
+
+    return sample_rate, samples, loop
+
+
+def smpl_chunk(sample_rate, loop):
+    """Builds the smpl chunk with one forward loop"""
+    start, end, play_count = loop
+    # manufacturer, product, sample period in ns, MIDI unity note, pitch fraction,
+    # SMPTE format and offset, the number of loops, sampler data
+    body = struct.pack('<9I', 0, 0, 1000000000 // sample_rate, 60, 0, 0, 0, 1, 0)
+    # cue point id, forward loop, start, inclusive end, fraction, play count
+    body += struct.pack('<6I', 0, 0, start, end - 1, 0, play_count)
+
+    return b'smpl' + struct.pack('<I', len(body)) + body
+
+
+def wav_header(encoded, sample_rate, loop=None):
+    """Builds the WAV header: RIFF, fmt, fact (for compressed formats), smpl (if there is a loop)
+    and the data chunk header. smpl comes before data, so the header has all the metadata."""
+    payload_size = len(encoded.payload)
+    block_align = encoded.block_align or encoded.bits // 8
+    byte_rate = sample_rate * block_align
+    if encoded.block_samples:
+        byte_rate = sample_rate * block_align // encoded.block_samples
+
+    fmt = struct.pack('<HHIIHH', encoded.audio_format, 1, sample_rate,
+                      byte_rate, block_align, encoded.bits)
+    fmt += encoded.fmt_extra
+
+    body = b'WAVE'
+    body += b'fmt ' + struct.pack('<I', len(fmt)) + fmt
+    if encoded.audio_format != WAV_FORMAT_PCM:
+        body += b'fact' + struct.pack('<II', 4, encoded.sample_count)
+    if loop is not None:
+        body += smpl_chunk(sample_rate, loop)
+    body += b'data' + struct.pack('<I', payload_size)
+
+    # chunks are padded to an even size, the padding is not in the chunk size
+    riff_size = len(body) + payload_size + (payload_size & 1)
+
+    return b'RIFF' + struct.pack('<I', riff_size) + body
+
+
+def wav_bytes(encoded, sample_rate, loop=None):
+    """Builds a WAV file with the fmt, fact (for compressed formats), smpl (if there is a loop)
+    and data chunks"""
+    payload = encoded.payload
+    data = wav_header(encoded, sample_rate, loop) + payload
+    if len(payload) & 1:
+        data += b'\0'
+
+    return data
+
+
+class Encoded:
+    """Encoded audio data and what the WAV header needs to describe it"""
+
+    def __init__(self, audio_format, bits, payload, sample_count,
+                 block_align=0, block_samples=0, fmt_extra=b''):
+        self.audio_format = audio_format
+        self.bits = bits
+        self.payload = payload
+        self.sample_count = sample_count
+        self.block_align = block_align
+        self.block_samples = block_samples
+        self.fmt_extra = fmt_extra
+
+
+def encode_pcm16(samples):
+    return Encoded(WAV_FORMAT_PCM, 16, struct.pack(f'<{len(samples)}h', *samples), len(samples))
+
+
+def encode_pcm8(samples):
+    # 8-bit WAV samples are unsigned with 128 as silence
+    return Encoded(WAV_FORMAT_PCM, 8, bytes(((s + 32768) >> 8) for s in samples), len(samples))
+
+
+def encode_dac12r(samples):
+    payload = struct.pack(f'<{len(samples)}H', *(((s + 32768) >> 4) for s in samples))
+    return Encoded(WAV_FORMAT_DAC12R, 16, payload, len(samples))
+
+
+def encode_dac12l(samples):
+    payload = struct.pack(f'<{len(samples)}H', *((s + 32768) for s in samples))
+    return Encoded(WAV_FORMAT_DAC12L, 16, payload, len(samples))
+
+
+MULAW_BIAS = 0x84
+MULAW_CLIP = 32635
+
+
+def linear_to_mulaw(sample):
+    sign = 0x80 if sample < 0 else 0
+    magnitude = min(abs(sample), MULAW_CLIP) + MULAW_BIAS
+
+    exponent = 7
+    while exponent > 0 and not magnitude & (0x4000 >> (7 - exponent)):
+        exponent -= 1
+    mantissa = (magnitude >> (exponent + 3)) & 0x0F
+
+    return ~(sign | (exponent << 4) | mantissa) & 0xFF
+
+
+def linear_to_alaw(sample):
+    # the sign bit set means a positive sample in A-law
+    sign = 0x80 if sample >= 0 else 0
+    magnitude = min(sample if sample >= 0 else -sample - 1, 32767)
+
+    if magnitude < 0x100:
+        code = magnitude >> 4
+    else:
+        exponent = magnitude.bit_length() - 8
+        code = (exponent << 4) | ((magnitude >> (exponent + 3)) & 0x0F)
+
+    return (sign | code) ^ 0x55
+
+
+def encode_mulaw(samples):
+    return Encoded(WAV_FORMAT_MULAW, 8, bytes(linear_to_mulaw(s) for s in samples), len(samples))
+
+
+def encode_alaw(samples):
+    return Encoded(WAV_FORMAT_ALAW, 8, bytes(linear_to_alaw(s) for s in samples), len(samples))
+
+
+ADPCM_STEPS = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767]
+ADPCM_INDEXES = [-1, -1, -1, -1, 2, 4, 6, 8]
+
+# the size of one IMA ADPCM block, the header takes 4 bytes
+ADPCM_BLOCK_ALIGN = 512
+
+
+def adpcm_encode_sample(sample, predictor, index):
+    """Encodes one sample, returns the 4-bit code and the decoder state after it"""
+    step = ADPCM_STEPS[index]
+    delta = sample - predictor
+    code = 0
+    if delta < 0:
+        code = 8
+        delta = -delta
+
+    # the same arithmetic as the decoder, so the encoder tracks it exactly
+    diff = step >> 3
+    if delta >= step:
+        code |= 4
+        delta -= step
+        diff += step
+    if delta >= step >> 1:
+        code |= 2
+        delta -= step >> 1
+        diff += step >> 1
+    if delta >= step >> 2:
+        code |= 1
+        diff += step >> 2
+
+    if code & 8:
+        predictor = max(predictor - diff, -32768)
+    else:
+        predictor = min(predictor + diff, 32767)
+
+    index = min(max(index + ADPCM_INDEXES[code & 7], 0), 88)
+
+    return code, predictor, index
+
+
+def encode_adpcm(samples):
+    block_samples = (ADPCM_BLOCK_ALIGN - 4) * 2 + 1
+    payload = bytearray()
+    index = 0
+
+    for start in range(0, len(samples), block_samples):
+        block = samples[start:start + block_samples]
+
+        # the block header holds the first sample as is
+        predictor = block[0]
+        payload += struct.pack('<hBB', predictor, index, 0)
+
+        codes = []
+        for sample in block[1:]:
+            code, predictor, index = adpcm_encode_sample(sample, predictor, index)
+            codes.append(code)
+
+        if len(codes) & 1:
+            codes.append(0)
+        for i in range(0, len(codes), 2):
+            payload.append(codes[i] | (codes[i + 1] << 4))
+
+    return Encoded(WAV_FORMAT_IMA_ADPCM, 4, bytes(payload), len(samples),
+                   ADPCM_BLOCK_ALIGN, block_samples, struct.pack('<HH', 2, block_samples))
+
+
+# the samples in one lossless frame, the same as the driver's DMA buffer half
+LOSSLESS_FRAME_SIZE = 512
+LOSSLESS_MAX_ORDER = 4
+LOSSLESS_VERBATIM = 0xFF
+
+
+class BitWriter:
+    """Writes bits MSB first"""
+
+    def __init__(self):
+        self.data = bytearray()
+        self.value = 0
+        self.count = 0
+
+    def write(self, value, bits):
+        self.value = (self.value << bits) | (value & ((1 << bits) - 1))
+        self.count += bits
+        while self.count >= 8:
+            self.count -= 8
+            self.data.append((self.value >> self.count) & 0xFF)
+        self.value &= (1 << self.count) - 1
+
+    def write_unary(self, zeros):
+        while zeros >= 16:
+            self.write(0, 16)
+            zeros -= 16
+        self.write(1, zeros + 1)
+
+    def align(self):
+        if self.count:
+            self.write(0, 8 - self.count)
+
+
+def lossless_residuals(frame, order):
+    """The residuals of the fixed predictor of the order, after the warm-up samples"""
+    residuals = []
+    for n in range(order, len(frame)):
+        h = frame[n - order:n][::-1]
+        if order == 0:
+            prediction = 0
+        elif order == 1:
+            prediction = h[0]
+        elif order == 2:
+            prediction = 2 * h[0] - h[1]
+        elif order == 3:
+            prediction = 3 * h[0] - 3 * h[1] + h[2]
+        else:
+            prediction = 4 * h[0] - 6 * h[1] + 4 * h[2] - h[3]
+        r = frame[n] - prediction
+        # zigzag to unsigned: 0, -1, 1, -2, 2...
+        residuals.append((r << 1) if r >= 0 else ((-r << 1) - 1))
+    return residuals
+
+
+def lossless_rice_bits(residuals, rice):
+    return sum((u >> rice) + 1 + rice for u in residuals)
+
+
+def encode_lossless(samples):
+    writer = BitWriter()
+
+    for start in range(0, len(samples), LOSSLESS_FRAME_SIZE):
+        frame = samples[start:start + LOSSLESS_FRAME_SIZE]
+
+        # the frame stored as is is the fallback
+        best = (16 * len(frame), 0, LOSSLESS_VERBATIM, None)
+        for order in range(min(LOSSLESS_MAX_ORDER, len(frame) - 1) + 1):
+            residuals = lossless_residuals(frame, order)
+            mean = sum(residuals) // max(len(residuals), 1)
+            guess = max(mean.bit_length() - 1, 0)
+            for rice in range(max(guess - 1, 0), min(guess + 2, 15) + 1):
+                bits = 16 * order + lossless_rice_bits(residuals, rice)
+                if bits < best[0]:
+                    best = (bits, order, rice, residuals)
+
+        _, order, rice, residuals = best
+        writer.write(order, 8)
+        writer.write(rice, 8)
+
+        if rice == LOSSLESS_VERBATIM:
+            for sample in frame:
+                writer.write(sample, 16)
+        else:
+            for sample in frame[:order]:
+                writer.write(sample, 16)
+            for u in residuals:
+                writer.write_unary(u >> rice)
+                if rice:
+                    writer.write(u, rice)
+
+        writer.align()
+
+    return Encoded(WAV_FORMAT_LOSSLESS, 16, bytes(writer.data), len(samples),
+                   LOSSLESS_FRAME_SIZE, LOSSLESS_FRAME_SIZE)
+
+
+ENCODERS = {
+    'pcm16': encode_pcm16,
+    'pcm8': encode_pcm8,
+    'dac12r': encode_dac12r,
+    'dac12l': encode_dac12l,
+    'mulaw': encode_mulaw,
+    'alaw': encode_alaw,
+    'adpcm': encode_adpcm,
+    'lossless': encode_lossless,
+}
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Converts WAV files for the stm32ldac driver')
+    parser.add_argument('--format', choices=ENCODERS.keys(), default='pcm16')
+    parser.add_argument('input')
+    parser.add_argument('output')
+    args = parser.parse_args()
+
+    sample_rate, samples, loop = read_wav(args.input)
+    encoded = ENCODERS[args.format](samples)
+
+    with open(args.output, 'wb') as f:
+        f.write(wav_bytes(encoded, sample_rate, loop))
+
+
+if __name__ == '__main__':
+    main()
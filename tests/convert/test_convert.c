@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2024 Farit N
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Host test of stm32ldac_convert: it must give exactly the values of
+ * stm32ldac_convert_ref for every alignment of the buffers and every length,
+ * and it must not write past the end of the output.
+ * The host must be little-endian like the Cortex-M4.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "convert.h"
+
+//the longest run, a few blocks of 8 samples and the odd tails
+#define MAX_COUNT 41
+
+//marks the output after the last sample
+#define GUARD 0xA5A5
+
+static int failures;
+
+#define EXPECT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+//xorshift32, the samples are the same on every run
+static uint32_t rng_state = 0x9E3779B9;
+
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+
+    return rng_state;
+}
+
+static void put_sample(uint8_t *p, int32_t sample)
+{
+    p[0] = sample & 0xFF;
+    p[1] = (sample >> 8) & 0xFF;
+}
+
+//converts the samples with both versions from every offset of the buffers
+static void compare(uint8_t const *samples, uint32_t count)
+{
+    //word aligned, so the offsets give every alignment
+    static uint32_t src_words[MAX_COUNT / 2 + 2];
+    static uint32_t ref_words[MAX_COUNT / 2 + 2];
+    static uint32_t dst_words[MAX_COUNT / 2 + 2];
+
+    for (uint32_t src_offset = 0; src_offset < 4; src_offset++) {
+        uint8_t *src = (uint8_t *)src_words + src_offset;
+        memcpy(src, samples, count * 2);
+
+        //the output is 2-byte aligned, a sustain loop can leave it off a word
+        for (uint32_t dst_offset = 0; dst_offset < 2; dst_offset++) {
+            uint16_t *ref = (uint16_t *)ref_words + dst_offset;
+            uint16_t *dst = (uint16_t *)dst_words + dst_offset;
+
+            for (uint32_t i = 0; i <= count; i++) {
+                ref[i] = GUARD;
+                dst[i] = GUARD;
+            }
+
+            stm32ldac_convert_ref(ref, src, count);
+            stm32ldac_convert(dst, src, count);
+
+            if (memcmp(ref, dst, (count + 1) * sizeof(uint16_t)) != 0) {
+                fprintf(stderr, "count %lu, src offset %lu, dst offset %lu: mismatch\n",
+                        (unsigned long)count, (unsigned long)src_offset, (unsigned long)dst_offset);
+                failures++;
+            }
+            EXPECT(dst[count] == GUARD);
+        }
+    }
+}
+
+//the values at the ends of the range and around the sign flip
+static void test_extremes(void)
+{
+    static const struct {
+        int32_t sample;
+        uint16_t value;
+    } cases[] = {
+        { -32768, 0 },
+        { -32768 + 15, 0 },
+        { -32768 + 16, 1 },
+        { -1, 2047 },
+        { 0, 2048 },
+        { 15, 2048 },
+        { 16, 2049 },
+        { 32767 - 16, 4094 },
+        { 32767, 4095 },
+    };
+    uint8_t samples[MAX_COUNT * 2];
+
+    for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        uint16_t value;
+
+        put_sample(samples, cases[i].sample);
+        stm32ldac_convert_ref(&value, samples, 1);
+        EXPECT(value == cases[i].value);
+        EXPECT(stm32ldac_dac_value(cases[i].sample) == cases[i].value);
+    }
+
+    //every length filled with the same extreme, the packed words have both halfwords set
+    static const int32_t fills[] = { -32768, -1, 0, 32767 };
+
+    for (uint32_t f = 0; f < sizeof(fills) / sizeof(fills[0]); f++) {
+        for (uint32_t i = 0; i < MAX_COUNT; i++) {
+            put_sample(samples + i * 2, fills[f]);
+        }
+        for (uint32_t count = 0; count <= MAX_COUNT; count++) {
+            compare(samples, count);
+        }
+    }
+}
+
+//all 65536 sample values, in runs of every length
+static void test_all_values(void)
+{
+    uint8_t samples[MAX_COUNT * 2];
+    uint32_t value = 0;
+
+    while (value < 0x10000) {
+        uint32_t count = 1 + value % MAX_COUNT;
+
+        for (uint32_t i = 0; i < count; i++) {
+            put_sample(samples + i * 2, (int32_t)((value + i) & 0xFFFF));
+        }
+        compare(samples, count);
+
+        value += count;
+    }
+}
+
+static void test_random(void)
+{
+    uint8_t samples[MAX_COUNT * 2];
+
+    for (int run = 0; run < 10000; run++) {
+        uint32_t count = rng() % (MAX_COUNT + 1);
+
+        for (uint32_t i = 0; i < count * 2; i++) {
+            samples[i] = rng();
+        }
+        compare(samples, count);
+    }
+}
+
+int main(void)
+{
+    test_extremes();
+    test_all_values();
+    test_random();
+
+    printf("%s\n", failures ? "FAILED" : "passed");
+
+    return failures ? 1 : 0;
+}
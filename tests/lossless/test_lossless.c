@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2024 Farit N
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Host test of the lossless decoder: a file encoded by scripts/gong_wav.py must decode
+ * to the samples of its 16-bit source, and truncated, corrupt or miscounted data
+ * must stop the decoding with an error without a read past the end of the data.
+ * The decoded and the source files are given on the command line.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "convert.h"
+#include "lossless.h"
+#include "wave.h"
+
+//the random mutations of the encoded data
+#define MUTATIONS 20000
+
+//the largest file that is read
+#define MAX_FILE_SIZE (1024 * 1024)
+
+//the samples decoded at a time, one DMA buffer half
+#define BLOCK_SIZE 512
+
+static int failures;
+
+#define EXPECT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+//xorshift32, the mutations are the same on every run
+static uint32_t rng_state = 0x6C8E9CF5;
+
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+
+    return rng_state;
+}
+
+static uint8_t *read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+
+    if (f == NULL) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        exit(1);
+    }
+
+    uint8_t *data = malloc(MAX_FILE_SIZE);
+    *size = fread(data, 1, MAX_FILE_SIZE, f);
+    fclose(f);
+
+    return data;
+}
+
+/*
+ * Decodes the data block by block like the driver, the data is copied into memory
+ * of its exact size, so AddressSanitizer catches a read past its end.
+ * Returns the result of the first failed block or 0, the values are in dst.
+ */
+static int decode(const uint8_t *data, size_t size, uint16_t frame_size, uint32_t samples, uint16_t *dst)
+{
+    uint8_t *copy = malloc(size ? size : 1);
+    LosslessState state;
+    int ret = 0;
+
+    memcpy(copy, data, size);
+    LOSSLESS_Init(&state, copy, size, frame_size, samples);
+
+    for (uint32_t done = 0; done < samples; done += BLOCK_SIZE) {
+        uint32_t count = (samples - done < BLOCK_SIZE) ? samples - done : BLOCK_SIZE;
+
+        ret = LOSSLESS_Decode(&state, dst + done, count);
+        if (ret != 0) {
+            break;
+        }
+    }
+
+    free(copy);
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s encoded.wav source.wav\n", argv[0]);
+        return 1;
+    }
+
+    size_t encoded_size;
+    size_t source_size;
+    uint8_t *encoded = read_file(argv[1], &encoded_size);
+    uint8_t *source = read_file(argv[2], &source_size);
+    WAVFile wav;
+    WAVFile pcm;
+
+    EXPECT(WAV_ParseFile(encoded, encoded_size, &wav) == WAV_OK);
+    EXPECT(WAV_ParseFile(source, source_size, &pcm) == WAV_OK);
+    EXPECT(wav.audio_format == WAV_FORMAT_LOSSLESS);
+    EXPECT(wav.sample_count == pcm.data_length / 2);
+    if (failures) {
+        return 1;
+    }
+
+    uint32_t samples = wav.sample_count;
+    uint16_t *expected = malloc(samples * sizeof(uint16_t));
+    uint16_t *dst = malloc((samples + BLOCK_SIZE) * sizeof(uint16_t));
+
+    stm32ldac_convert_ref(expected, pcm.data, samples);
+
+    printf("%lu samples in %lu bytes, frames of %u\n",
+        (unsigned long)samples, (unsigned long)wav.data_length, wav.block_align);
+
+    //the whole file is bit exact
+    EXPECT(decode(wav.data, wav.data_length, wav.block_align, samples, dst) == 0);
+    EXPECT(memcmp(dst, expected, samples * sizeof(uint16_t)) == 0);
+
+    //the data ends before the last sample
+    for (uint32_t length = 0; length < wav.data_length; length++) {
+        EXPECT(decode(wav.data, length, wav.block_align, samples, dst) != 0);
+    }
+
+    //the fact chunk says there are more samples than the data has
+    EXPECT(decode(wav.data, wav.data_length, wav.block_align, samples + 1, dst) != 0);
+    EXPECT(decode(wav.data, wav.data_length, wav.block_align, samples + BLOCK_SIZE, dst) != 0);
+
+    uint8_t *data = malloc(wav.data_length);
+
+    //the order and the Rice parameter of the first frame out of range
+    memcpy(data, wav.data, wav.data_length);
+    data[0] = LOSSLESS_MAX_ORDER + 1;
+    EXPECT(decode(data, wav.data_length, wav.block_align, samples, dst) != 0);
+
+    memcpy(data, wav.data, wav.data_length);
+    data[1] = LOSSLESS_MAX_RICE + 1;
+    EXPECT(decode(data, wav.data_length, wav.block_align, samples, dst) != 0);
+
+    //a frame of zeros is one unary run to the end of the data
+    memset(data, 0, wav.data_length);
+    EXPECT(decode(data, wav.data_length, wav.block_align, samples, dst) != 0);
+
+    //random changes stop with an error or decode to some values, never past the end
+    for (int i = 0; i < MUTATIONS; i++) {
+        memcpy(data, wav.data, wav.data_length);
+
+        uint32_t changes = 1 + rng() % 8;
+        for (uint32_t c = 0; c < changes; c++) {
+            data[rng() % wav.data_length] ^= 1 << (rng() % 8);
+        }
+
+        decode(data, wav.data_length, wav.block_align, samples, dst);
+    }
+
+    free(data);
+    free(dst);
+    free(expected);
+    free(source);
+    free(encoded);
+
+    printf("%s\n", failures ? "FAILED" : "passed");
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2024 Farit N
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef CHECK_WAVE_H__
+#define CHECK_WAVE_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wave.h"
+
+/**
+ * Parses the file from a buffer of exactly its size, so AddressSanitizer
+ * catches any read past the end, and checks that the pointers the parser
+ * gives back stay inside the file.
+ *
+ * @return the result of WAV_ParseFile
+ */
+static inline WAVResult check_wave(const uint8_t *data, size_t size)
+{
+    uint8_t *file = malloc(size ? size : 1);
+    WAVFile wav;
+
+    memcpy(file, data, size);
+
+    WAVResult result = WAV_ParseFile(file, size, &wav);
+
+    if (result == WAV_OK) {
+        const uint8_t *end = file + size;
+
+        if ((wav.fmt == NULL) || (wav.fmt < file) || (wav.fmt_size > (size_t)(end - wav.fmt))) {
+            fprintf(stderr, "the fmt chunk is outside the file\n");
+            abort();
+        }
+
+        if ((wav.data == NULL) || (wav.data < file) || (wav.data_length > (size_t)(end - wav.data))) {
+            fprintf(stderr, "the data chunk is outside the file\n");
+            abort();
+        }
+
+        if ((wav.loop_end != 0) && (wav.loop_end <= wav.loop_start)) {
+            fprintf(stderr, "the loop ends before it starts\n");
+            abort();
+        }
+    }
+
+    free(file);
+
+    return result;
+}
+
+#endif
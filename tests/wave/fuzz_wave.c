@@ -0,0 +1,15 @@
+/*
+ * Copyright (c) 2024 Farit N
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "check_wave.h"
+
+//run with the seed corpus: fuzz_wave corpus ../../app/audio
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    check_wave(data, size);
+
+    return 0;
+}
@@ -0,0 +1,440 @@
+/*
+ * Copyright (c) 2024 Farit N
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Host test of WAV_ParseFile: the malformed header cases, every truncation
+ * of the seed files and a fixed number of random mutations of them.
+ * The seed files are given on the command line.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check_wave.h"
+
+//the random mutations of every seed file
+#define MUTATIONS 20000
+
+//the largest seed file that is read
+#define MAX_FILE_SIZE (1024 * 1024)
+
+static int failures;
+
+#define EXPECT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+//a WAV file that is built in memory chunk by chunk
+struct builder {
+    uint8_t data[512];
+    size_t size;
+};
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    put_u16(p, v & 0xFFFF);
+    put_u16(p + 2, v >> 16);
+}
+
+static void begin(struct builder *b)
+{
+    memcpy(b->data, "RIFF\0\0\0\0WAVE", 12);
+    b->size = 12;
+}
+
+//the chunk with its size field, the body is padded to an even size
+static void add_chunk(struct builder *b, const char *id, const void *body, uint32_t body_size, uint32_t size_field)
+{
+    memcpy(b->data + b->size, id, 4);
+    put_u32(b->data + b->size + 4, size_field);
+    memcpy(b->data + b->size + 8, body, body_size);
+    b->size += 8 + body_size;
+
+    if (body_size & 1) {
+        b->data[b->size++] = 0;
+    }
+}
+
+static void add(struct builder *b, const char *id, const void *body, uint32_t body_size)
+{
+    add_chunk(b, id, body, body_size, body_size);
+}
+
+//the RIFF size is the rest of the file
+static size_t end(struct builder *b)
+{
+    put_u32(b->data + 4, b->size - 8);
+
+    return b->size;
+}
+
+static void fmt_body(uint8_t *body, uint16_t format, uint16_t channels, uint32_t rate, uint16_t bits)
+{
+    uint16_t align = channels * bits / 8;
+
+    put_u16(body, format);
+    put_u16(body + 2, channels);
+    put_u32(body + 4, rate);
+    put_u32(body + 8, rate * align);
+    put_u16(body + 12, align);
+    put_u16(body + 14, bits);
+}
+
+static const uint8_t samples[16] = { 0x00, 0x00, 0xE8, 0x03, 0x18, 0xFC, 0xFF, 0x7F, 0x00, 0x80 };
+
+static void build_pcm(struct builder *b)
+{
+    uint8_t fmt[16];
+
+    fmt_body(fmt, WAV_FORMAT_PCM, 1, 16000, 16);
+    begin(b);
+    add(b, "fmt ", fmt, sizeof(fmt));
+    add(b, "data", samples, sizeof(samples));
+    end(b);
+}
+
+static WAVResult parse(struct builder *b, WAVFile *wav)
+{
+    EXPECT(check_wave(b->data, b->size) == WAV_ParseFile(b->data, b->size, wav));
+
+    return WAV_ParseFile(b->data, b->size, wav);
+}
+
+static void test_valid(void)
+{
+    struct builder b;
+    WAVFile wav;
+
+    build_pcm(&b);
+
+    EXPECT(parse(&b, &wav) == WAV_OK);
+    EXPECT(wav.audio_format == WAV_FORMAT_PCM);
+    EXPECT(wav.number_of_channels == 1);
+    EXPECT(wav.sample_rate == 16000);
+    EXPECT(wav.bits_per_sample == 16);
+    EXPECT(wav.block_align == 2);
+    EXPECT(wav.data == b.data + 12 + 8 + 16 + 8);
+    EXPECT(wav.data_length == sizeof(samples));
+    EXPECT(wav.loop_end == 0);
+}
+
+static void test_not_riff(void)
+{
+    struct builder b;
+    WAVFile wav;
+
+    build_pcm(&b);
+
+    //shorter than the RIFF header
+    EXPECT(WAV_ParseFile(b.data, 11, &wav) == WAV_ERROR_NOT_RIFF);
+    EXPECT(check_wave(b.data, 0) == WAV_ERROR_NOT_RIFF);
+
+    b.data[0] = 'X';
+    EXPECT(parse(&b, &wav) == WAV_ERROR_NOT_RIFF);
+
+    build_pcm(&b);
+    b.data[8] = 'X';
+    EXPECT(parse(&b, &wav) == WAV_ERROR_NOT_RIFF);
+
+    //the RIFF chunk must hold at least "WAVE"
+    build_pcm(&b);
+    put_u32(b.data + 4, 3);
+    EXPECT(parse(&b, &wav) == WAV_ERROR_NOT_RIFF);
+}
+
+static void test_truncated(void)
+{
+    struct builder b;
+    WAVFile wav;
+
+    //the RIFF size is larger than the memory, the RIFF chunk takes the rest of it
+    build_pcm(&b);
+    put_u32(b.data + 4, b.size - 8 + 1);
+    EXPECT(parse(&b, &wav) == WAV_OK);
+    EXPECT(wav.data_length == sizeof(samples));
+
+    //a streamed file without the RIFF and the data sizes
+    static const uint32_t unset[] = { 0, UINT32_MAX };
+
+    for (uint32_t i = 0; i < sizeof(unset) / sizeof(unset[0]); i++) {
+        build_pcm(&b);
+        put_u32(b.data + 4, unset[i]);
+        put_u32(b.data + 12 + 8 + 16 + 4, UINT32_MAX);
+        EXPECT(parse(&b, &wav) == WAV_OK);
+        EXPECT(wav.data_length == sizeof(samples));
+    }
+
+    //a chunk before the data goes past the end of the RIFF chunk
+    uint8_t fmt[16];
+    fmt_body(fmt, WAV_FORMAT_PCM, 1, 16000, 16);
+    begin(&b);
+    add_chunk(&b, "fmt ", fmt, sizeof(fmt), 0x7FFFFFF0);
+    add(&b, "data", samples, sizeof(samples));
+    end(&b);
+    EXPECT(parse(&b, &wav) == WAV_ERROR_TRUNCATED);
+
+    //the memory is shorter than the file, the data is cut at its end
+    build_pcm(&b);
+    EXPECT(check_wave(b.data, b.size - 1) == WAV_OK);
+    EXPECT(WAV_ParseFile(b.data, b.size - 1, &wav) == WAV_OK);
+    EXPECT(wav.data_length == sizeof(samples) - 1);
+
+    //the memory ends in the fmt chunk
+    EXPECT(check_wave(b.data, 12 + 8 + 15) == WAV_ERROR_TRUNCATED);
+}
+
+static void test_fmt(void)
+{
+    struct builder b;
+    WAVFile wav;
+    uint8_t fmt[40] = { 0 };
+
+    //no fmt chunk
+    begin(&b);
+    add(&b, "data", samples, sizeof(samples));
+    end(&b);
+    EXPECT(parse(&b, &wav) == WAV_ERROR_NO_FMT);
+
+    //the fmt chunk is too short
+    fmt_body(fmt, WAV_FORMAT_PCM, 1, 16000, 16);
+    begin(&b);
+    add(&b, "fmt ", fmt, 14);
+    add(&b, "data", samples, sizeof(samples));
+    end(&b);
+    EXPECT(parse(&b, &wav) == WAV_ERROR_NO_FMT);
+
+    //the format of WAVE_FORMAT_EXTENSIBLE is in the sub format GUID
+    fmt_body(fmt, WAV_FORMAT_EXTENSIBLE, 1, 8000, 16);
+    put_u16(fmt + 16, 22);
+    put_u16(fmt + 24, WAV_FORMAT_MULAW);
+    begin(&b);
+    add(&b, "fmt ", fmt, sizeof(fmt));
+    add(&b, "data", samples, sizeof(samples));
+    end(&b);
+    EXPECT(parse(&b, &wav) == WAV_OK);
+    EXPECT(wav.audio_format == WAV_FORMAT_MULAW);
+
+    //too short for the sub format, the tag is kept
+    begin(&b);
+    add(&b, "fmt ", fmt, 24);
+    add(&b, "data", samples, sizeof(samples));
+    end(&b);
+    EXPECT(parse(&b, &wav) == WAV_OK);
+    EXPECT(wav.audio_format == WAV_FORMAT_EXTENSIBLE);
+}
+
+static void test_data(void)
+{
+    struct builder b;
+    WAVFile wav;
+    uint8_t fmt[16];
+
+    fmt_body(fmt, WAV_FORMAT_PCM, 1, 16000, 16);
+
+    //no data chunk
+    begin(&b);
+    add(&b, "fmt ", fmt, sizeof(fmt));
+    end(&b);
+    EXPECT(parse(&b, &wav) == WAV_ERROR_NO_DATA);
+
+    //a streamed file without the data size, the data takes the rest of the file
+    begin(&b);
+    add(&b, "fmt ", fmt, sizeof(fmt));
+    add_chunk(&b, "data", samples, sizeof(samples), UINT32_MAX);
+    end(&b);
+    EXPECT(parse(&b, &wav) == WAV_OK);
+    EXPECT(wav.data_length == sizeof(samples));
+
+    //an odd chunk is padded, the chunk after it is found
+    uint8_t list[7] = "INFOab";
+    begin(&b);
+    add(&b, "fmt ", fmt, sizeof(fmt));
+    add(&b, "LIST", list, sizeof(list));
+    add(&b, "data", samples, 9);
+    end(&b);
+    EXPECT(parse(&b, &wav) == WAV_OK);
+    EXPECT(wav.data_length == 9);
+
+    //the fact chunk of compressed audio
+    uint8_t fact[4];
+    put_u32(fact, 505);
+    begin(&b);
+    add(&b, "fmt ", fmt, sizeof(fmt));
+    add(&b, "fact", fact, sizeof(fact));
+    add(&b, "data", samples, sizeof(samples));
+    end(&b);
+    EXPECT(parse(&b, &wav) == WAV_OK);
+    EXPECT(wav.sample_count == 505);
+}
+
+static void test_smpl(void)
+{
+    struct builder b;
+    WAVFile wav;
+    uint8_t fmt[16];
+    uint8_t smpl[36 + 24] = { 0 };
+
+    fmt_body(fmt, WAV_FORMAT_PCM, 1, 16000, 16);
+
+    //one loop of samples 2-5, the end is inclusive in the file
+    put_u32(smpl + 28, 1);
+    put_u32(smpl + 36 + 8, 2);
+    put_u32(smpl + 36 + 12, 5);
+    put_u32(smpl + 36 + 20, 3);
+    begin(&b);
+    add(&b, "fmt ", fmt, sizeof(fmt));
+    add(&b, "data", samples, sizeof(samples));
+    add(&b, "smpl", smpl, sizeof(smpl));
+    end(&b);
+    EXPECT(parse(&b, &wav) == WAV_OK);
+    EXPECT(wav.loop_start == 2);
+    EXPECT(wav.loop_end == 6);
+    EXPECT(wav.loop_play_count == 3);
+
+    //the loop ends before it starts, it's ignored
+    put_u32(smpl + 36 + 8, 5);
+    put_u32(smpl + 36 + 12, 2);
+    begin(&b);
+    add(&b, "fmt ", fmt, sizeof(fmt));
+    add(&b, "data", samples, sizeof(samples));
+    add(&b, "smpl", smpl, sizeof(smpl));
+    end(&b);
+    EXPECT(parse(&b, &wav) == WAV_OK);
+    EXPECT(wav.loop_end == 0);
+
+    //the end would overflow
+    put_u32(smpl + 36 + 8, 0);
+    put_u32(smpl + 36 + 12, UINT32_MAX);
+    begin(&b);
+    add(&b, "fmt ", fmt, sizeof(fmt));
+    add(&b, "data", samples, sizeof(samples));
+    add(&b, "smpl", smpl, sizeof(smpl));
+    end(&b);
+    EXPECT(parse(&b, &wav) == WAV_OK);
+    EXPECT(wav.loop_end == 0);
+
+    //too short for a loop
+    begin(&b);
+    add(&b, "fmt ", fmt, sizeof(fmt));
+    add(&b, "data", samples, sizeof(samples));
+    add(&b, "smpl", smpl, 40);
+    end(&b);
+    EXPECT(parse(&b, &wav) == WAV_OK);
+    EXPECT(wav.loop_end == 0);
+}
+
+//xorshift32, the mutations are the same on every run
+static uint32_t rng_state = 0x2545F491;
+
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+
+    return rng_state;
+}
+
+//the sizes that are most likely to break the bounds checks
+static const uint32_t edge_sizes[] = { 0, 1, 3, 4, 7, 8, 15, 16, 0x7FFFFFFF, 0x80000000, 0xFFFFFFF8, 0xFFFFFFFF };
+
+static void mutate(uint8_t *file, size_t size)
+{
+    uint32_t changes = 1 + rng() % 4;
+
+    for (uint32_t i = 0; i < changes; i++) {
+        //the headers are at the start of the file, most changes go there
+        size_t pos = (rng() & 1) ? rng() % (size < 64 ? size : 64) : rng() % size;
+
+        switch (rng() % 3) {
+        case 0:
+            file[pos] ^= 1 << (rng() % 8);
+            break;
+        case 1:
+            file[pos] = rng();
+            break;
+        default:
+            if (pos + 4 <= size) {
+                put_u32(file + pos, edge_sizes[rng() % (sizeof(edge_sizes) / sizeof(edge_sizes[0]))]);
+            }
+            break;
+        }
+    }
+}
+
+//every truncation and the random mutations of a valid file must be parsed without a read past its end
+static void test_seed(const uint8_t *seed, size_t size)
+{
+    uint8_t *file = malloc(size);
+
+    EXPECT(check_wave(seed, size) == WAV_OK);
+
+    for (size_t length = 0; length < size; length++) {
+        check_wave(seed, length);
+    }
+
+    for (int i = 0; i < MUTATIONS; i++) {
+        memcpy(file, seed, size);
+        mutate(file, size);
+        check_wave(file, size);
+        check_wave(file, rng() % (size + 1));
+    }
+
+    free(file);
+}
+
+static void test_seed_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+
+    if (f == NULL) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        failures++;
+        return;
+    }
+
+    uint8_t *data = malloc(MAX_FILE_SIZE);
+    size_t size = fread(data, 1, MAX_FILE_SIZE, f);
+    fclose(f);
+
+    printf("seed %s, %zu bytes\n", path, size);
+    test_seed(data, size);
+
+    free(data);
+}
+
+int main(int argc, char **argv)
+{
+    struct builder b;
+
+    test_valid();
+    test_not_riff();
+    test_truncated();
+    test_fmt();
+    test_data();
+    test_smpl();
+
+    build_pcm(&b);
+    test_seed(b.data, b.size);
+
+    for (int i = 1; i < argc; i++) {
+        test_seed_file(argv[i]);
+    }
+
+    printf("%s\n", failures ? "FAILED" : "passed");
+
+    return failures ? 1 : 0;
+}